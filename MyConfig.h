@@ -253,6 +253,87 @@
 #define MY_OTA_FLASH_JDECID 0x1F65
 #endif
 
+/**
+ * @def MY_OTA_WINDOW_SIZE
+ * @brief Number of firmware blocks requested ahead during an OTA firmware update (1-32).
+ *
+ * The node keeps this many block requests outstanding and writes blocks to flash in the order they
+ * arrive. Blocks missing after @ref MY_OTA_RETRY_DELAY are requested again, one request per missing block.
+ * Blocks that arrive while the radio is busy may be dropped, which costs a retry, so lower this if the
+ * receive buffer of the radio is small.
+ *
+ * The default of 1 requests one block at a time, as before. To opt in, define a larger window (e.g. 8)
+ * before including MySensors.h, once the controller or gateway serving the firmware answers several
+ * outstanding block requests.
+ */
+#ifndef MY_OTA_WINDOW_SIZE
+#define MY_OTA_WINDOW_SIZE (1u)
+#endif
+
+/**
+ * @def MY_OTA_COMPRESSION
+ * @brief Accept compressed firmware during OTA firmware updates.
+ *
+ * The node announces support in its FW config request. A compressed firmware is received into the flash
+ * area at FIRMWARE_TRANSFER_OFFSET and decompressed into place once complete, before the CRC check.
+ * The transfer area follows room for the largest image, FIRMWARE_MAX_SIZE (the program memory of the
+ * target, at most 64 KB), so this needs a flash of more than twice that size, 128 KB for 32 KB targets.
+ * It also needs about 30 bytes of RAM.
+ */
+//#define MY_OTA_COMPRESSION
+
+/**
+ * @def MY_OTA_DELTA
+ * @brief Accept firmware updates as patch against the running firmware (AVR only).
+ *
+ * At boot the node checks the program memory against the CRC of the firmware config in eeprom and
+ * announces patch support if it matches. A patch is received into the flash area at
+ * FIRMWARE_TRANSFER_OFFSET and applied with the running firmware to rebuild the new one, which is then
+ * verified with the regular CRC check. Like @ref MY_OTA_COMPRESSION, this needs a flash of more than
+ * twice FIRMWARE_MAX_SIZE.
+ */
+//#define MY_OTA_DELTA
+
+/**
+ * @def MY_OTA_MULTICAST
+ * @brief Accept firmware blocks broadcast by the gateway during OTA firmware updates.
+ *
+ * The node announces support in its FW config request. A gateway with @ref MY_OTA_FIRMWARE_SERVER then
+ * broadcasts the firmware once to all nodes updating to it. The node keeps a bitmap of the missing blocks
+ * at FIRMWARE_MULTICAST_BITMAP_OFFSET in flash, after the transfer area, and reports them in ranges at the
+ * end of each round. This needs one more flash sector than @ref MY_OTA_COMPRESSION, 128 KB for 32 KB
+ * targets. Patches are still sent to the node by unicast.
+ */
+//#define MY_OTA_MULTICAST
+
+/**
+ * @def MY_OTA_FIRMWARE_SERVER
+ * @brief Let the gateway serve firmware images to the nodes (Linux gateways only).
+ *
+ * Firmware config and block requests are answered by the gateway from the images in
+ * @ref MY_OTA_FIRMWARE_SERVER_DIR, without a round trip to the controller for every block.
+ * Requests for firmware types without an image are forwarded to the controller.
+ */
+//#define MY_OTA_FIRMWARE_SERVER
+
+/**
+ * @def MY_OTA_FIRMWARE_SERVER_DIR
+ * @brief Directory with the firmware images served by @ref MY_OTA_FIRMWARE_SERVER.
+ *
+ * Images are named <type>-<version>.hex (Intel HEX) or <type>-<version>.bin, type and version in decimal.
+ */
+#ifndef MY_OTA_FIRMWARE_SERVER_DIR
+#define MY_OTA_FIRMWARE_SERVER_DIR "/etc/mysensors/firmware"
+#endif
+
+/**
+ * @def MY_OTA_MULTICAST_INTERVAL
+ * @brief Interval in ms between two firmware blocks broadcast by @ref MY_OTA_FIRMWARE_SERVER.
+ */
+#ifndef MY_OTA_MULTICAST_INTERVAL
+#define MY_OTA_MULTICAST_INTERVAL (50ul)
+#endif
+
 
 /**********************************
 *  Gateway config
@@ -397,6 +478,90 @@
 #define MY_VERIFICATION_TIMEOUT_MS 5000
 #endif
 
+/**
+ * @def MY_SIGNING_SOFT_MAX_SESSIONS
+ * @brief Number of concurrent verification sessions kept by the soft signing backend.
+ *
+ * Each node requesting a nonce gets its own session with an independent timeout, so several
+ * nodes can have signed messages in flight towards this node at the same time. If all sessions
+ * are in use, the oldest one is evicted. Every session costs about 30 bytes of RAM.
+ * The Linux gateway keeps one session for every possible node.
+ */
+#ifndef MY_SIGNING_SOFT_MAX_SESSIONS
+#if defined(__linux__)
+#define MY_SIGNING_SOFT_MAX_SESSIONS (255u)
+#else
+#define MY_SIGNING_SOFT_MAX_SESSIONS (1u)
+#endif
+#endif
+
+/**
+ * @def MY_SIGNING_NONCE_PREFETCH
+ * @brief Enable this to request the nonce for the next signed message in advance.
+ *
+ * After a signed message has been sent, a new nonce is requested from the same destination and
+ * kept until the next signed message to that node. That message can then be signed and sent right
+ * away instead of waiting a full nonce request/response round trip. A prefetched nonce is only used
+ * if it is younger than half of @ref MY_VERIFICATION_TIMEOUT_MS, otherwise a new one is requested.
+ * This costs one extra nonce request per signed message if the node rarely talks to the same
+ * destination twice.
+ * A prefetch request takes a verification session on the destination until it times out, with a single
+ * session it evicts the nonce of another node waiting for it. The soft backend therefore needs
+ * @ref MY_SIGNING_SOFT_MAX_SESSIONS > 1, on the verifiers of the network as well.
+ */
+//#define MY_SIGNING_NONCE_PREFETCH
+
+/**
+ * @def MY_SIGNING_NONCE_CACHE_SIZE
+ * @brief Number of destinations for which a nonce is prefetched (@ref MY_SIGNING_NONCE_PREFETCH).
+ *
+ * If all entries are in use, the oldest one is reused. Every entry costs about 30 bytes of RAM.
+ */
+#ifndef MY_SIGNING_NONCE_CACHE_SIZE
+#if defined(__linux__)
+#define MY_SIGNING_NONCE_CACHE_SIZE (255u)
+#else
+#define MY_SIGNING_NONCE_CACHE_SIZE (1u)
+#endif
+#endif
+
+/**
+ * @def MY_TRANSPORT_ENCRYPTION
+ * @brief Enable this to protect all transport frames with AES-CCM authenticated encryption.
+ *
+ * Every frame is encrypted and authenticated hop by hop with the AES key personalized with
+ * @ref SecurityPersonalizer.ino. A frame counter kept in EEPROM replaces the nonce exchange of
+ * signing, so secure messages need a single transmission and replayed frames are rejected.
+ * A frame counter and a 4 byte MAC are appended to every frame, which limits the payload to
+ * @ref MAX_TX_PAYLOAD (17) bytes: longer payloads are truncated when set on a message.
+ * Works with all transports, all nodes in the network must enable it.
+ * Cannot be combined with signing, @ref MY_RF24_ENABLE_ENCRYPTION or OTA firmware updates
+ * (firmware blocks do not fit). Every node needs a static @ref MY_NODE_ID, as the node ID is
+ * part of the nonce.
+ *
+ * The frame counter is stored behind the 256 bytes of sketch configuration in EEPROM, followed
+ * by the highest frame counter seen from each neighbour (see @ref MY_TRANSPORT_ENCRYPTION_MAX_NODES).
+ * Replayed frames are rejected across restarts, a restarted node drops up to 16 frames of each
+ * neighbour. Never reuse a key after clearing the EEPROM, as the frame counter starts over and
+ * the neighbours reject the node.
+ */
+//#define MY_TRANSPORT_ENCRYPTION
+
+/**
+ * @def MY_TRANSPORT_ENCRYPTION_MAX_NODES
+ * @brief Number of neighbours tracked for replay protection by @ref MY_TRANSPORT_ENCRYPTION.
+ *
+ * A neighbour is tracked from its first frame on and never dropped, frames of further neighbours are
+ * rejected (!TSF:ENC:FULL). Every entry costs 9 bytes of RAM and 5 bytes of EEPROM.
+ */
+#ifndef MY_TRANSPORT_ENCRYPTION_MAX_NODES
+#if defined(__linux__)
+#define MY_TRANSPORT_ENCRYPTION_MAX_NODES (64u)
+#else
+#define MY_TRANSPORT_ENCRYPTION_MAX_NODES (8u)
+#endif
+#endif
+
 /**
  * @def MY_SIGNING_NODE_WHITELISTING
  * @brief Enable to turn on whitelisting
@@ -471,6 +636,35 @@
 // Enables RF24 encryption (all nodes and gateway must have this enabled, and all must be personalized with the same AES key)
 //#define MY_RF24_ENABLE_ENCRYPTION
 
+/**
+ * @def MY_RF24_ENCRYPTION_BYTE_AES
+ * @brief Use the byte oriented AES engine for RF24 encryption on 32-bit targets.
+ *
+ * On 32-bit targets (Linux, SAMD, ESP8266) RF24 encryption and @ref MY_TRANSPORT_ENCRYPTION use a word oriented AES engine with
+ * 2kB of lookup tables, and on Linux the AES instructions of the CPU (AES-NI or ARMv8 crypto
+ * extensions) when available. Enable this to use the smaller byte oriented engine instead.
+ * AVR always uses the byte oriented engine. Both engines produce identical ciphertext.
+ */
+//#define MY_RF24_ENCRYPTION_BYTE_AES
+
+/**
+ * @def MY_RF24_ACK_PAYLOAD
+ * @brief Deliver messages to neighbours not listening with the ACK of their next message.
+ *
+ * If a message addressed to a neighbour (e.g. a sleeping node) is not acknowledged, it is preloaded as
+ * ACK payload and handed over with the hardware ACK of the next message of that node, without a separate
+ * transmission. One message is kept, a newer undelivered message replaces it.
+ *
+ * The payload goes with the ACK of the first message received, which may be from another node. It is
+ * tagged with an unused protocol version: nodes other than its destination drop it, nodes without this
+ * option reject it. It is preloaded again unless all messages received until it was sent (TX_DS) came
+ * from the destination. In rare cases the destination gets the message twice.
+ *
+ * Enable on all nodes. Messages are preloaded by nodes with @ref MY_RX_MESSAGE_BUFFER_FEATURE (IRQ pin),
+ * e.g. gateways and repeaters. Cannot be combined with @ref MY_RF24_ENABLE_ENCRYPTION.
+ */
+//#define MY_RF24_ACK_PAYLOAD
+
 /**
  * @def MY_DEBUG_VERBOSE_RF24
  * @brief Enable MY_DEBUG_VERBOSE_RF24 flag for verbose debug prints related to the RF24 driver. Requires DEBUG to be enabled.
@@ -510,6 +704,8 @@
 #define MY_RF24_CS_PIN 3
 #elif defined(LINUX_ARCH_RASPBERRYPI)
 #define MY_RF24_CS_PIN 24
+#elif defined(LINUX_ARCH_GENERIC)
+#define MY_RF24_CS_PIN SS
 #else
 #define MY_RF24_CS_PIN 10
 #endif
@@ -519,17 +715,18 @@
 * @def MY_RX_MESSAGE_BUFFER_FEATURE
 * @brief This enabled the receiving buffer feature.
 *
-* This feature is currently not supported for RFM69 and RS485, for RF24 MY_RF24_IRQ_PIN has to be defined.
+* This feature is currently not supported for RS485, for RF24 MY_RF24_IRQ_PIN has to be defined.
+* With the IRQ pin, RF24 also waits for the end of a transmission on the interrupt instead of polling the radio.
 */
 //#define MY_RX_MESSAGE_BUFFER_FEATURE
 
 /**
  * @def MY_RX_MESSAGE_BUFFER_SIZE
- * @brief Declare the amount of incoming messages that can be buffered.
+ * @brief Declare the amount of incoming messages that can be buffered, a power of two.
  */
 #ifdef MY_RX_MESSAGE_BUFFER_FEATURE
 #ifndef MY_RX_MESSAGE_BUFFER_SIZE
-#define MY_RX_MESSAGE_BUFFER_SIZE  (20)
+#define MY_RX_MESSAGE_BUFFER_SIZE  (16)
 #endif
 #endif
 
@@ -683,6 +880,17 @@
 // Enables RFM69 encryption (all nodes and gateway must have this enabled, and all must be personalized with the same AES key)
 //#define MY_RFM69_ENABLE_ENCRYPTION
 
+/**
+ * @def MY_RFM69_GW_BACKGROUND_SEND
+ * @brief Send gateway downlinks in the background, incoming messages are processed during the ACK wait.
+ *
+ * A downlink returns as sent once it has started, a missing radio ACK is only indicated
+ * (INDICATION_ERR_TX, !TSF:SND:NACK). Messages requesting an ACK still wait and return the result.
+ * Without this option the gateway waits for the ACK of every downlink.
+ * Requires MY_RX_MESSAGE_BUFFER_FEATURE, the frames received meanwhile are queued by the interrupt handler.
+ */
+//#define MY_RFM69_GW_BACKGROUND_SEND
+
 /**********************************
 *  RFM95 driver defaults
 ***********************************/
@@ -934,6 +1142,26 @@
 #define MY_LINUX_CONFIG_FILE "/etc/mysensors.dat"
 #endif
 
+/**
+ * @def MY_LINUX_SPI_DEVICE
+ * @brief SPI device of the radio on boards without a dedicated driver (not Raspberry Pi)
+ *
+ * The device selects the chip, the default CS pin (SS) is not a GPIO.
+ */
+#ifndef MY_LINUX_SPI_DEVICE
+#define MY_LINUX_SPI_DEVICE "/dev/spidev0.0"
+#endif
+
+/**
+ * @def MY_LINUX_GPIO_CHIP
+ * @brief GPIO chip device on boards without a dedicated driver (not Raspberry Pi)
+ *
+ * Pin numbers, e.g. of @ref MY_RF24_CE_PIN, are the line offsets of this chip.
+ */
+#ifndef MY_LINUX_GPIO_CHIP
+#define MY_LINUX_GPIO_CHIP "/dev/gpiochip0"
+#endif
+
 #endif	// MyConfig_h
 
 // Doxygen specific constructs, not included when built normally
@@ -943,9 +1171,18 @@
 #define MY_SIGNING_SOFT
 #define MY_SIGNING_REQUEST_SIGNATURES
 #define MY_SIGNING_GW_REQUEST_SIGNATURES_FROM_ALL
+#define MY_SIGNING_NONCE_PREFETCH
+#define MY_RF24_ENCRYPTION_BYTE_AES
+#define MY_RF24_ACK_PAYLOAD
+#define MY_TRANSPORT_ENCRYPTION
+#define MY_OTA_COMPRESSION
+#define MY_OTA_DELTA
+#define MY_OTA_MULTICAST
+#define MY_OTA_FIRMWARE_SERVER
 #define MY_SIGNING_NODE_WHITELISTING {{.nodeId = GATEWAY_ADDRESS,.serial = {0x09,0x08,0x07,0x06,0x05,0x04,0x03,0x02,0x01}}}
 #define MY_RS485_HWSERIAL
 #define MY_IS_RFM69HW
+#define MY_RFM69_GW_BACKGROUND_SEND
 #define MY_PARENT_NODE_IS_STATIC
 #define MY_REGISTRATION_CONTROLLER
 #define MY_TRANSPORT_UPLINK_CHECK_DISABLED
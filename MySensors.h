@@ -129,6 +129,9 @@ MY_DEFAULT_RX_LED_PIN in your sketch instead to enable LEDs
 #if defined(MY_SIGNING_ATSHA204) && defined(__linux__)
 #error No support for ATSHA204 on this platform
 #endif
+#if defined(MY_SIGNING_SOFT) && defined(MY_SIGNING_NONCE_PREFETCH) && (MY_SIGNING_SOFT_MAX_SESSIONS < 2)
+#error MY_SIGNING_NONCE_PREFETCH requires MY_SIGNING_SOFT_MAX_SESSIONS > 1, a prefetch request would evict the only verification session
+#endif
 
 #if defined(MY_SIGNING_ATSHA204)
 #include "core/MySigningAtsha204.cpp"
@@ -223,6 +226,14 @@ MY_DEFAULT_RX_LED_PIN in your sketch instead to enable LEDs
 #endif
 #endif
 
+// GATEWAY - OTA FIRMWARE SERVER
+#if defined(MY_OTA_FIRMWARE_SERVER)
+#if !defined(MY_GATEWAY_FEATURE) || !defined(__linux__)
+#error MY_OTA_FIRMWARE_SERVER is only available on Linux gateways
+#endif
+#include "core/MyOTAFirmwareServer.cpp"
+#endif
+
 // RAM ROUTING TABLE
 #if defined(MY_RAM_ROUTING_TABLE_FEATURE) && defined(MY_REPEATER_FEATURE)
 // activate feature based on architecture
@@ -254,10 +265,33 @@ MY_DEFAULT_RX_LED_PIN in your sketch instead to enable LEDs
 #include "drivers/AVR/DigitalIO/DigitalIO.h"
 #endif
 
-#if defined(MY_RADIO_NRF24) && defined(__linux__) && !defined(LINUX_ARCH_RASPBERRYPI)
+#if defined(MY_RADIO_NRF24) && defined(__linux__) && !(defined(LINUX_ARCH_RASPBERRYPI) || defined(LINUX_ARCH_GENERIC))
 #error No support for nRF24 radio on this platform
 #endif
 
+#if defined(MY_RF24_ENABLE_ENCRYPTION) || defined(MY_TRANSPORT_ENCRYPTION)
+#if defined(MY_RF24_ENCRYPTION_BYTE_AES)
+#define AES_NO_TTABLE
+#endif
+#include "drivers/AES/AES.cpp"
+#endif
+
+#if defined(MY_TRANSPORT_ENCRYPTION)
+#if defined(MY_RF24_ENABLE_ENCRYPTION)
+#error MY_TRANSPORT_ENCRYPTION replaces MY_RF24_ENABLE_ENCRYPTION, enable only one of them
+#endif
+#if defined(MY_SIGNING_FEATURE)
+#error Signed messages leave no room for the frame counter and MAC of MY_TRANSPORT_ENCRYPTION
+#endif
+#if defined(MY_OTA_FIRMWARE_FEATURE) || defined(MY_OTA_FIRMWARE_SERVER)
+#error Firmware blocks exceed the payload left by MY_TRANSPORT_ENCRYPTION
+#endif
+#if !defined(MY_GATEWAY_FEATURE) && (MY_NODE_ID == AUTO)
+#error MY_TRANSPORT_ENCRYPTION requires a static MY_NODE_ID, nodes without ID would share frame nonces
+#endif
+#include "core/MyTransportEncryption.cpp"
+#endif
+
 #include "core/MyTransport.cpp"
 
 // count enabled transports
@@ -288,9 +322,6 @@ MY_DEFAULT_RX_LED_PIN in your sketch instead to enable LEDs
 #endif
 
 #if defined(MY_RADIO_NRF24)
-#if defined(MY_RF24_ENABLE_ENCRYPTION)
-#include "drivers/AES/AES.cpp"
-#endif
 #include "drivers/RF24/RF24.cpp"
 #include "core/MyTransportNRF24.cpp"
 #elif defined(MY_RS485)
@@ -302,6 +333,9 @@ MY_DEFAULT_RX_LED_PIN in your sketch instead to enable LEDs
 #endif
 #include "core/MyTransportRS485.cpp"
 #elif defined(MY_RADIO_RFM69)
+#if defined(MY_RFM69_GW_BACKGROUND_SEND) && !defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+#error MY_RFM69_GW_BACKGROUND_SEND requires MY_RX_MESSAGE_BUFFER_FEATURE, frames received during a background send would be lost
+#endif
 #include "drivers/RFM69/RFM69.cpp"
 #include "core/MyTransportRFM69.cpp"
 #elif defined(MY_RADIO_RFM95)
@@ -47,6 +47,9 @@
 #define SIZE_SIGNING_SOFT_SERIAL			(9)		//!< Size soft signing serial
 #define SIZE_RF_ENCRYPTION_AES_KEY			(16)	//!< Size RF AES encryption key
 #define SIZE_NODE_LOCK_COUNTER				(1)		//!< Size node lock counter
+#define SIZE_LOCAL_CONFIG					(256)	//!< Size sketch static configuration
+#define SIZE_TRANSPORT_ENCRYPTION_COUNTER	(4)		//!< Size transport encryption frame counter
+#define SIZE_TRANSPORT_ENCRYPTION_PEER		(5)		//!< Size transport encryption neighbour entry, node ID and frame counter
 
 
 /** @brief EEPROM start address */
@@ -83,6 +86,12 @@
 #define EEPROM_NODE_LOCK_COUNTER (EEPROM_RF_ENCRYPTION_AES_KEY_ADDRESS + SIZE_RF_ENCRYPTION_AES_KEY)
 /** @brief First free address for sketch static configuration */
 #define EEPROM_LOCAL_CONFIG_ADDRESS (EEPROM_NODE_LOCK_COUNTER + SIZE_NODE_LOCK_COUNTER)
+#if defined(MY_TRANSPORT_ENCRYPTION)
+/** @brief Address transport encryption frame counter, behind the sketch static configuration */
+#define EEPROM_TRANSPORT_ENCRYPTION_COUNTER_ADDRESS (EEPROM_LOCAL_CONFIG_ADDRESS + SIZE_LOCAL_CONFIG)
+/** @brief Address transport encryption neighbour table, @ref MY_TRANSPORT_ENCRYPTION_MAX_NODES entries */
+#define EEPROM_TRANSPORT_ENCRYPTION_PEERS_ADDRESS (EEPROM_TRANSPORT_ENCRYPTION_COUNTER_ADDRESS + SIZE_TRANSPORT_ENCRYPTION_COUNTER)
+#endif
 
 #endif // MyEepromAddresses_h
 
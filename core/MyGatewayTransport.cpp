@@ -52,7 +52,7 @@ inline void gatewayTransportProcess(void)
 					inclusionModeSet(atoi(_msg.data) == 1);
 #endif
 				} else {
-					_processInternalMessages();
+					_processInternalMessages(_msg);
 				}
 			} else {
 				// Call incoming message callback if available
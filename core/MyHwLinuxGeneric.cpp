@@ -28,6 +28,10 @@ static SoftEeprom eeprom = SoftEeprom(MY_LINUX_CONFIG_FILE, 1024);	// ATMega328
 
 void hwInit()
 {
+#if defined(LINUX_ARCH_GENERIC)
+	SPI.setDevice(MY_LINUX_SPI_DEVICE);
+	setChip(MY_LINUX_GPIO_CHIP);
+#endif
 #ifdef MY_GATEWAY_SERIAL
 	MY_SERIALDEVICE.begin(MY_BAUD_RATE);
 #ifdef MY_LINUX_SERIAL_GROUPNAME
@@ -61,7 +65,11 @@ void hwWriteConfig(int addr, uint8_t value)
 
 void hwRandomNumberInit()
 {
-	randomSeed(time(NULL));
+	unsigned long seed;
+	if (hwGetentropy(&seed, sizeof(seed)) != sizeof(seed)) {
+		seed = time(NULL);
+	}
+	randomSeed(seed);
 }
 
 unsigned long hwMillis()
@@ -130,3 +138,20 @@ void hwDebugPrint(const char *fmt, ...)
 	va_end(args);
 }
 #endif
+
+#if defined(LINUX_ARCH_GENERIC)
+void hwDigitalWrite(uint8_t pin, uint8_t value)
+{
+	digitalWrite(pin, value);
+}
+
+int hwDigitalRead(uint8_t pin)
+{
+	return digitalRead(pin);
+}
+
+void hwPinMode(uint8_t pin, uint8_t mode)
+{
+	pinMode(pin, mode);
+}
+#endif
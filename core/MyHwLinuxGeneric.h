@@ -21,6 +21,7 @@
 #define MyHwLinuxGeneric_h
 
 #include <cstdlib>
+#include <sys/types.h>
 #include <pthread.h>
 #include "MyHw.h"
 #include "SerialPort.h"
@@ -39,9 +40,18 @@ SerialPort Serial = SerialPort(MY_LINUX_SERIAL_PORT);
 #define hwWatchdogReset()
 #define hwReboot()
 
+#if defined(LINUX_ARCH_GENERIC)
+// spidev and GPIO character device
+#include <SPI.h>
+
+inline void hwDigitalWrite(uint8_t, uint8_t);
+inline int hwDigitalRead(uint8_t);
+inline void hwPinMode(uint8_t, uint8_t);
+#else
 #define hwDigitalWrite(__pin, __value) _Pragma("GCC error \"Not supported on linux-generic\"")
 #define hwDigitalRead(__pin) _Pragma("GCC error \"Not supported on linux-generic\"")
 #define hwPinMode(__pin, __value) _Pragma("GCC error \"Not supported on linux-generic\"")
+#endif
 
 void hwInit();
 inline void hwReadConfigBlock(void* buf, void* addr, size_t length);
@@ -49,6 +59,7 @@ inline void hwWriteConfigBlock(void* buf, void* addr, size_t length);
 inline uint8_t hwReadConfig(int addr);
 inline void hwWriteConfig(int addr, uint8_t value);
 inline void hwRandomNumberInit();
+ssize_t hwGetentropy(void* buffer, size_t length);
 inline unsigned long hwMillis();
 
 #ifdef MY_RF24_IRQ_PIN
@@ -78,8 +89,8 @@ static __inline__ void __hwLock()
 #if defined(DOXYGEN)
 #define ATOMIC_BLOCK
 #elif defined(MY_RF24_IRQ_PIN)
-#define ATOMIC_BLOCK for ( ATOMIC_BLOCK_CLEANUP, __hwLock(); \
-                           __atomic_loop ; __atomic_loop = 0 )
+#define ATOMIC_BLOCK for ( ATOMIC_BLOCK_CLEANUP; \
+                           __atomic_loop && (__hwLock(), 1) ; __atomic_loop = 0 )
 #else
 #define ATOMIC_BLOCK
 #endif	/* DOXYGEN */
@@ -60,7 +60,11 @@ void hwWriteConfig(int adr, uint8_t value)
 
 void hwRandomNumberInit()
 {
-	randomSeed(time(NULL));
+	unsigned long seed;
+	if (hwGetentropy(&seed, sizeof(seed)) != sizeof(seed)) {
+		seed = time(NULL);
+	}
+	randomSeed(seed);
 }
 
 unsigned long hwMillis()
@@ -61,6 +61,7 @@ typedef enum {
 	INDICATION_ERR_FW_FLASH_INIT,             //!< Firmware update flash initialisation failure.
 	INDICATION_ERR_FW_TIMEOUT,                //!< Firmware update timeout.
 	INDICATION_ERR_FW_CHECKSUM,               //!< Firmware update checksum mismatch.
+	INDICATION_ERR_DECRYPT,                   //!< Received frame failed authentication or was replayed.
 	INDICATION_ERR_END
 } indication_t;
 
@@ -229,7 +229,7 @@ MyMessage& MyMessage::setDestination(uint8_t _destination)
 // Set payload
 MyMessage& MyMessage::set(void* value, uint8_t length)
 {
-	uint8_t payloadLength = value == NULL ? 0 : min(length, (uint8_t)MAX_PAYLOAD);
+	uint8_t payloadLength = value == NULL ? 0 : min(length, (uint8_t)MAX_TX_PAYLOAD);
 	miSetLength(payloadLength);
 	miSetPayloadType(P_CUSTOM);
 	memcpy(data, value, payloadLength);
@@ -238,7 +238,7 @@ MyMessage& MyMessage::set(void* value, uint8_t length)
 
 MyMessage& MyMessage::set(const char* value)
 {
-	uint8_t length = value == NULL ? 0 : min(strlen(value), (size_t)MAX_PAYLOAD);
+	uint8_t length = value == NULL ? 0 : min(strlen(value), (size_t)MAX_TX_PAYLOAD);
 	miSetLength(length);
 	miSetPayloadType(P_STRING);
 	if (length) {
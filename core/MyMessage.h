@@ -39,6 +39,11 @@
 #define MAX_MESSAGE_LENGTH	(32u)	//!< The maximum size of a message (including header)
 #define HEADER_SIZE			(7u)	//!< The size of the header
 #define MAX_PAYLOAD (MAX_MESSAGE_LENGTH - HEADER_SIZE) //!< The maximum size of a payload depends on #MAX_MESSAGE_LENGTH and #HEADER_SIZE
+#if defined(MY_TRANSPORT_ENCRYPTION)
+#define MAX_TX_PAYLOAD (MAX_PAYLOAD - 8u) //!< The maximum size of a payload set, leaves room for the frame counter and MAC of MY_TRANSPORT_ENCRYPTION
+#else
+#define MAX_TX_PAYLOAD MAX_PAYLOAD //!< The maximum size of a payload set
+#endif
 
 /// @brief The command field (message-type) defines the overall properties of a message
 typedef enum {
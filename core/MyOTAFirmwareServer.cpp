@@ -0,0 +1,768 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include "MyOTAFirmwareServer.h"
+#include <dirent.h>
+#include <stddef.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// global variables
+extern MyMessage _msgTmp;
+
+// local variables
+static firmwareServerImage_t *_firmwareServerImages = NULL;
+static size_t _firmwareServerImageCount = 0;
+static time_t _firmwareServerModified = 0;	// Newest modification time in the image directory when last loaded
+static firmwareServerSession_t _firmwareServerSessions[FIRMWARE_SERVER_SESSIONS];
+
+// Store data at address, the image grows as needed and gaps are filled with 0xFF
+static bool firmwareServerStore(uint8_t **image, uint32_t *capacity, uint32_t *size,
+                                const uint32_t address, const uint8_t *data, const uint32_t length)
+{
+	if (address + length > FIRMWARE_SERVER_MAX_SIZE) {
+		return false;
+	}
+	if (address + length > *capacity) {
+		const uint32_t newCapacity = (address + length + 4095u) & ~4095u;
+		uint8_t *newImage = (uint8_t *)realloc(*image, newCapacity);
+		if (!newImage) {
+			return false;
+		}
+		(void)memset(newImage + *capacity, 0xFF, newCapacity - *capacity);
+		*image = newImage;
+		*capacity = newCapacity;
+	}
+	(void)memcpy(*image + address, data, length);
+	if (address + length > *size) {
+		*size = address + length;
+	}
+	return true;
+}
+
+// Value of two hex digits, -1 if not hex
+static int16_t firmwareServerHexByte(const char *hex)
+{
+	int16_t value = 0;
+	for (uint8_t i = 0; i < 2; i++) {
+		const char c = hex[i];
+		value <<= 4;
+		if (c >= '0' && c <= '9') {
+			value |= c - '0';
+		} else if (c >= 'A' && c <= 'F') {
+			value |= c - 'A' + 10;
+		} else if (c >= 'a' && c <= 'f') {
+			value |= c - 'a' + 10;
+		} else {
+			return -1;
+		}
+	}
+	return value;
+}
+
+// Read an Intel HEX file, supports data, end of file and extended segment/linear address records
+static bool firmwareServerReadHex(FILE *file, uint8_t **image, uint32_t *capacity, uint32_t *size)
+{
+	char line[600];
+	uint32_t base = 0;
+	while (fgets(line, sizeof(line), file)) {
+		if (line[0] != ':') {
+			continue;
+		}
+		uint8_t record[256 + 5];
+		const size_t digits = strcspn(line + 1, "\r\n");
+		if (digits < 10 || digits & 1 || digits / 2 > sizeof(record)) {
+			return false;
+		}
+		uint8_t checksum = 0;
+		for (size_t i = 0; i < digits / 2; i++) {
+			const int16_t value = firmwareServerHexByte(line + 1 + i * 2);
+			if (value < 0) {
+				return false;
+			}
+			record[i] = (uint8_t)value;
+			checksum += record[i];
+		}
+		const uint8_t length = record[0];
+		if (checksum || digits / 2 != (size_t)length + 5u) {
+			return false;
+		}
+		const uint16_t address = (uint16_t)(record[1] << 8) | record[2];
+		switch (record[3]) {
+		case 0x00:	// data
+			if (!firmwareServerStore(image, capacity, size, base + address, record + 4, length)) {
+				return false;
+			}
+			break;
+		case 0x01:	// end of file
+			return true;
+		case 0x02:	// extended segment address
+			base = (((uint32_t)record[4] << 8) | record[5]) << 4;
+			break;
+		case 0x04:	// extended linear address
+			base = (((uint32_t)record[4] << 8) | record[5]) << 16;
+			break;
+		default:	// start addresses
+			break;
+		}
+	}
+	return false;
+}
+
+static bool firmwareServerReadBin(FILE *file, uint8_t **image, uint32_t *capacity, uint32_t *size)
+{
+	uint8_t buffer[1024];
+	size_t length;
+	while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		if (!firmwareServerStore(image, capacity, size, *size, buffer, length)) {
+			return false;
+		}
+	}
+	return !ferror(file);
+}
+
+// crc16 over the image, same as the node calculates in transportIsValidFirmware()
+static uint16_t firmwareServerCrc(const uint8_t *data, const uint32_t length)
+{
+	uint16_t crc = ~0;
+	for (uint32_t i = 0; i < length; ++i) {
+		crc ^= data[i];
+		for (int8_t j = 0; j < 8; ++j) {
+			if (crc & 1) {
+				crc = (crc >> 1) ^ 0xA001;
+			} else {
+				crc = (crc >> 1);
+			}
+		}
+	}
+	return crc;
+}
+
+// Compress to the LZSS format described at replyFirmwareConfigCompressed_t, returns the compressed size.
+// Output needs room for length + length / 8 + 1 bytes.
+static uint32_t firmwareServerCompress(const uint8_t *input, const uint32_t length, uint8_t *output)
+{
+	// hash chains over the 3 byte prefixes of the window
+	int32_t *head = (int32_t *)malloc(4096 * sizeof(int32_t));
+	int32_t *previous = (int32_t *)malloc(length * sizeof(int32_t));
+	if (!head || !previous) {
+		free(head);
+		free(previous);
+		return 0;
+	}
+	for (uint16_t i = 0; i < 4096; i++) {
+		head[i] = -1;
+	}
+	uint32_t out = 0;
+	uint32_t flagsPos = 0;
+	uint8_t item = 8;
+	uint32_t position = 0;
+	while (position < length) {
+		if (item == 8) {
+			flagsPos = out++;
+			output[flagsPos] = 0;
+			item = 0;
+		}
+		uint32_t bestLength = 0;
+		uint32_t bestDistance = 0;
+		if (position + FIRMWARE_LZ_MIN_MATCH <= length) {
+			const uint16_t hash = ((input[position] << 4) ^ (input[position + 1] << 2) ^ input[position + 2]) &
+			                      4095;
+			int32_t candidate = head[hash];
+			const uint32_t maxLength = length - position < FIRMWARE_LZ_MAX_MATCH ? length - position :
+			                           FIRMWARE_LZ_MAX_MATCH;
+			for (uint16_t chain = 0; candidate >= 0 && position - candidate <= FIRMWARE_LZ_WINDOW &&
+			        chain < FIRMWARE_SERVER_LZ_CHAIN; chain++) {
+				uint32_t matchLength = 0;
+				while (matchLength < maxLength && input[candidate + matchLength] == input[position + matchLength]) {
+					matchLength++;
+				}
+				if (matchLength > bestLength) {
+					bestLength = matchLength;
+					bestDistance = position - candidate;
+				}
+				candidate = previous[candidate];
+			}
+		}
+		if (bestLength < FIRMWARE_LZ_MIN_MATCH) {
+			bestLength = 1;
+			output[out++] = input[position];
+		} else {
+			output[flagsPos] |= 1 << item;
+			output[out++] = (uint8_t)((bestDistance - 1) >> 4);
+			output[out++] = (uint8_t)(((bestDistance - 1) << 4) | (bestLength - FIRMWARE_LZ_MIN_MATCH));
+		}
+		item++;
+		// add the covered positions to the hash chains
+		for (const uint32_t end = position + bestLength; position < end; position++) {
+			if (position + FIRMWARE_LZ_MIN_MATCH <= length) {
+				const uint16_t hash = ((input[position] << 4) ^ (input[position + 1] << 2) ^ input[position + 2]) &
+				                      4095;
+				previous[position] = head[hash];
+				head[hash] = position;
+			}
+		}
+	}
+	free(head);
+	free(previous);
+	return out;
+}
+
+static uint32_t firmwareServerMatch(const uint8_t *a, const uint8_t *b, const uint32_t maxLength)
+{
+	uint32_t length = 0;
+	while (length < maxLength && a[length] == b[length]) {
+		length++;
+	}
+	return length;
+}
+
+// Encode target as patch against base in the format described at replyFirmwareConfigTransfer_t,
+// returns the patch size. Output needs room for size + size / 128 + 1 bytes.
+static uint32_t firmwareServerDiff(const uint8_t *base, const uint32_t baseSize, const uint8_t *target,
+                                   const uint32_t size, uint8_t *output)
+{
+	// hash chains over the 4 byte prefixes of the base
+	int32_t *head = (int32_t *)malloc(4096 * sizeof(int32_t));
+	int32_t *previous = (int32_t *)malloc((baseSize + 1) * sizeof(int32_t));
+	if (!head || !previous) {
+		free(head);
+		free(previous);
+		return 0;
+	}
+	for (uint16_t i = 0; i < 4096; i++) {
+		head[i] = -1;
+	}
+	for (uint32_t i = 0; i + FIRMWARE_DELTA_MIN_COPY <= baseSize; i++) {
+		const uint16_t hash = ((base[i] << 6) ^ (base[i + 1] << 4) ^ (base[i + 2] << 2) ^ base[i + 3]) & 4095;
+		previous[i] = head[hash];
+		head[hash] = i;
+	}
+	uint32_t out = 0;
+	uint32_t literalPos = 0;
+	uint8_t literals = 0;
+	int32_t offset = 0;	// offset of the last copy, code moved as a whole keeps it
+	uint32_t position = 0;
+	while (position < size) {
+		const uint32_t maxLength = size - position < FIRMWARE_DELTA_MAX_COPY ? size - position :
+		                           FIRMWARE_DELTA_MAX_COPY;
+		uint32_t bestLength = 0;
+		int32_t bestOffset = offset;
+		const int32_t source = (int32_t)position + offset;
+		if (source >= 0 && (uint32_t)source < baseSize) {
+			bestLength = firmwareServerMatch(base + source, target + position,
+			                                 baseSize - source < maxLength ? baseSize - source : maxLength);
+		}
+		if (bestLength < maxLength && position + FIRMWARE_DELTA_MIN_COPY <= size) {
+			const uint8_t *p = target + position;
+			int32_t candidate = head[((p[0] << 6) ^ (p[1] << 4) ^ (p[2] << 2) ^ p[3]) & 4095];
+			for (uint16_t chain = 0; candidate >= 0 && chain < FIRMWARE_SERVER_LZ_CHAIN; chain++) {
+				const int32_t candidateOffset = candidate - (int32_t)position;
+				if (candidateOffset >= INT16_MIN && candidateOffset <= INT16_MAX) {
+					const uint32_t length = firmwareServerMatch(base + candidate, p,
+					                        baseSize - candidate < maxLength ? baseSize - candidate : maxLength);
+					if (length > bestLength) {
+						bestLength = length;
+						bestOffset = candidateOffset;
+					}
+				}
+				candidate = previous[candidate];
+			}
+		}
+		if (bestLength >= FIRMWARE_DELTA_MIN_COPY) {
+			output[out++] = 0x80 | (uint8_t)(bestLength - FIRMWARE_DELTA_MIN_COPY);
+			output[out++] = (uint8_t)bestOffset;
+			output[out++] = (uint8_t)(bestOffset >> 8);
+			offset = bestOffset;
+			literals = 0;
+			position += bestLength;
+		} else {
+			if (!literals || literals == 0x80) {
+				literalPos = out++;
+				literals = 0;
+			}
+			output[literalPos] = literals++;
+			output[out++] = target[position++];
+		}
+	}
+	free(head);
+	free(previous);
+	return out;
+}
+
+// Patch of image against base, made on first use
+static const firmwareServerPatch_t *firmwareServerPatch(firmwareServerImage_t *image,
+        const firmwareServerImage_t *base)
+{
+	for (const firmwareServerPatch_t *patch = image->patches; patch; patch = patch->next) {
+		if (patch->baseVersion == base->config.version) {
+			return patch;
+		}
+	}
+	firmwareServerPatch_t *patch = (firmwareServerPatch_t *)malloc(sizeof(firmwareServerPatch_t));
+	if (!patch) {
+		return NULL;
+	}
+	const uint32_t size = (uint32_t)image->config.blocks * FIRMWARE_BLOCK_SIZE;
+	patch->baseVersion = base->config.version;
+	patch->blocks = 0;
+	patch->data = (uint8_t *)malloc(size + size / 128 + FIRMWARE_BLOCK_SIZE + 1);
+	if (patch->data) {
+		const uint32_t patchSize = firmwareServerDiff(base->data,
+		                           (uint32_t)base->config.blocks * FIRMWARE_BLOCK_SIZE, image->data, size, patch->data);
+		const uint32_t blocks = (patchSize + FIRMWARE_BLOCK_SIZE - 1) / FIRMWARE_BLOCK_SIZE;
+		if (patchSize && blocks < image->config.blocks) {
+			(void)memset(patch->data + patchSize, 0xFF, blocks * FIRMWARE_BLOCK_SIZE - patchSize);
+			patch->blocks = (uint16_t)blocks;
+		} else {
+			free(patch->data);
+			patch->data = NULL;
+		}
+	}
+	OTA_DEBUG(PSTR("OTA:SRV:PATCH,T=%d,V=%d,BV=%d,B=%d\n"), image->config.type, image->config.version,
+	          patch->baseVersion, patch->blocks);
+	patch->next = image->patches;
+	image->patches = patch;
+	return patch;
+}
+
+// Keep a compressed copy of the image if it takes fewer blocks
+static void firmwareServerCompressImage(firmwareServerImage_t *image)
+{
+	const uint32_t size = (uint32_t)image->config.blocks * FIRMWARE_BLOCK_SIZE;
+	image->compressed = (uint8_t *)malloc(size + size / 8 + FIRMWARE_BLOCK_SIZE + 1);
+	image->compressedBlocks = 0;
+	if (!image->compressed) {
+		return;
+	}
+	const uint32_t compressedSize = firmwareServerCompress(image->data, size, image->compressed);
+	const uint32_t blocks = (compressedSize + FIRMWARE_BLOCK_SIZE - 1) / FIRMWARE_BLOCK_SIZE;
+	if (!compressedSize || blocks >= image->config.blocks) {
+		free(image->compressed);
+		image->compressed = NULL;
+		return;
+	}
+	(void)memset(image->compressed + compressedSize, 0xFF, blocks * FIRMWARE_BLOCK_SIZE - compressedSize);
+	image->compressedBlocks = (uint16_t)blocks;
+}
+
+static bool firmwareServerLoadImage(const char *path, const bool hex, firmwareServerImage_t *image)
+{
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		return false;
+	}
+	uint8_t *data = NULL;
+	uint32_t capacity = 0;
+	uint32_t size = 0;
+	bool ok = hex ? firmwareServerReadHex(file, &data, &capacity, &size) :
+	          firmwareServerReadBin(file, &data, &capacity, &size);
+	(void)fclose(file);
+	// pad to full pages like the controllers do, the padding is part of the CRC
+	const uint32_t padded = (size + FIRMWARE_SERVER_PAGE_SIZE - 1) / FIRMWARE_SERVER_PAGE_SIZE *
+	                        FIRMWARE_SERVER_PAGE_SIZE;
+	const uint8_t pad = 0xFF;
+	ok = ok && size && (padded == size ||
+	                    firmwareServerStore(&data, &capacity, &size, padded - 1, &pad, 1));
+	if (!ok) {
+		free(data);
+		return false;
+	}
+	image->data = data;
+	image->config.blocks = size / FIRMWARE_BLOCK_SIZE;
+	image->config.crc = firmwareServerCrc(data, size);
+	image->patches = NULL;
+	firmwareServerCompressImage(image);
+	return true;
+}
+
+static void firmwareServerUnload(void)
+{
+	for (size_t i = 0; i < _firmwareServerImageCount; i++) {
+		free(_firmwareServerImages[i].data);
+		free(_firmwareServerImages[i].compressed);
+		firmwareServerPatch_t *patch = _firmwareServerImages[i].patches;
+		while (patch) {
+			firmwareServerPatch_t *next = patch->next;
+			free(patch->data);
+			free(patch);
+			patch = next;
+		}
+	}
+	free(_firmwareServerImages);
+	_firmwareServerImages = NULL;
+	_firmwareServerImageCount = 0;
+}
+
+// Parse <type>-<version>.hex or <type>-<version>.bin
+static bool firmwareServerParseName(const char *name, uint16_t *type, uint16_t *version, bool *hex)
+{
+	unsigned int fwType, fwVersion;
+	char extension[4];
+	int length = 0;
+	if (sscanf(name, "%u-%u.%3s%n", &fwType, &fwVersion, extension, &length) != 3 || name[length] ||
+	        fwType > 0xFFFF || fwVersion > 0xFFFF) {
+		return false;
+	}
+	*hex = !strcmp(extension, "hex");
+	if (!*hex && strcmp(extension, "bin")) {
+		return false;
+	}
+	*type = (uint16_t)fwType;
+	*version = (uint16_t)fwVersion;
+	return true;
+}
+
+// Newest modification time of the image directory and the files in it, 0 if not readable
+static time_t firmwareServerModified(void)
+{
+	struct stat info;
+	if (stat(MY_OTA_FIRMWARE_SERVER_DIR, &info)) {
+		return 0;
+	}
+	time_t modified = info.st_mtime;
+	DIR *dir = opendir(MY_OTA_FIRMWARE_SERVER_DIR);
+	if (!dir) {
+		return 0;
+	}
+	struct dirent *entry;
+	char path[PATH_MAX];
+	while ((entry = readdir(dir)) != NULL) {
+		(void)snprintf(path, sizeof(path), "%s/%s", MY_OTA_FIRMWARE_SERVER_DIR, entry->d_name);
+		if (!stat(path, &info) && info.st_mtime > modified) {
+			modified = info.st_mtime;
+		}
+	}
+	(void)closedir(dir);
+	return modified;
+}
+
+// (Re)load all images if the directory changed since the last load
+static void firmwareServerRefresh(void)
+{
+	const time_t modified = firmwareServerModified();
+	if (modified == _firmwareServerModified) {
+		return;
+	}
+	_firmwareServerModified = modified;
+	firmwareServerUnload();
+	DIR *dir = opendir(MY_OTA_FIRMWARE_SERVER_DIR);
+	if (!dir) {
+		return;
+	}
+	struct dirent *entry;
+	char path[PATH_MAX];
+	while ((entry = readdir(dir)) != NULL) {
+		firmwareServerImage_t image;
+		uint16_t type, version;
+		bool hex;
+		if (!firmwareServerParseName(entry->d_name, &type, &version, &hex)) {
+			continue;
+		}
+		image.config.type = type;
+		image.config.version = version;
+		(void)snprintf(path, sizeof(path), "%s/%s", MY_OTA_FIRMWARE_SERVER_DIR, entry->d_name);
+		if (!firmwareServerLoadImage(path, hex, &image)) {
+			OTA_DEBUG(PSTR("!OTA:SRV:LOAD FAIL,%s\n"), path);
+			continue;
+		}
+		firmwareServerImage_t *images = (firmwareServerImage_t *)realloc(_firmwareServerImages,
+		                                (_firmwareServerImageCount + 1) * sizeof(firmwareServerImage_t));
+		if (!images) {
+			free(image.data);
+			free(image.compressed);
+			break;
+		}
+		_firmwareServerImages = images;
+		_firmwareServerImages[_firmwareServerImageCount++] = image;
+		OTA_DEBUG(PSTR("OTA:SRV:LOAD,T=%d,V=%d,B=%d,C=%04X,Z=%d\n"), image.config.type, image.config.version,
+		          image.config.blocks, image.config.crc, image.compressedBlocks);
+	}
+	(void)closedir(dir);
+}
+
+// Highest version of type, or the exact version if specified
+static firmwareServerImage_t *firmwareServerFind(const uint16_t type, const bool exact,
+        const uint16_t version)
+{
+	firmwareServerImage_t *found = NULL;
+	for (size_t i = 0; i < _firmwareServerImageCount; i++) {
+		firmwareServerImage_t *image = &_firmwareServerImages[i];
+		if (image->config.type != type) {
+			continue;
+		}
+		if (exact ? image->config.version == version : (!found ||
+		        image->config.version > found->config.version)) {
+			found = image;
+		}
+	}
+	return found;
+}
+
+// Report progress to the controller
+static void firmwareServerNotify(const char *format, const uint16_t id, const uint16_t value)
+{
+	// id is a node ID, or the firmware type for multicast sessions
+	char text[MAX_PAYLOAD + 1];
+	(void)snprintf(text, sizeof(text), format, id, value);
+	MyMessage msg;
+	(void)gatewayTransportSend(buildGw(msg, I_LOG_MESSAGE).set(text));
+}
+
+// Data and number of blocks of an image in the given encoding, NULL if not available
+static const uint8_t *firmwareServerData(const uint16_t type, const uint16_t version,
+        const uint8_t flags, uint16_t *blocks)
+{
+	firmwareServerImage_t *image = firmwareServerFind(type, true, version);
+	if (!image) {
+		return NULL;
+	}
+	if (flags & FIRMWARE_FLAG_COMPRESSED) {
+		*blocks = image->compressedBlocks;
+		return image->compressed;
+	}
+	*blocks = image->config.blocks;
+	return image->data;
+}
+
+// Mark blocks for broadcast in the session of the firmware, the session is opened if needed
+static void firmwareServerMulticastAdd(const uint16_t type, const uint16_t version, const uint8_t flags,
+                                       const uint16_t blocks, uint16_t first, uint16_t count)
+{
+	firmwareServerSession_t *session = NULL;
+	for (uint8_t i = 0; i < FIRMWARE_SERVER_SESSIONS; i++) {
+		firmwareServerSession_t *candidate = &_firmwareServerSessions[i];
+		if (candidate->pending && candidate->type == type && candidate->version == version &&
+		        candidate->flags == flags) {
+			session = candidate;
+			break;
+		}
+		if (!candidate->pending && !session) {
+			session = candidate;
+		}
+	}
+	if (!session) {
+		OTA_DEBUG(PSTR("!OTA:MCS:NO SESSION,T=%d\n"), type);
+		return;
+	}
+	if (!session->pending) {
+		session->pending = (uint8_t *)calloc((blocks + 7u) / 8u, 1);
+		if (!session->pending) {
+			return;
+		}
+		session->type = type;
+		session->version = version;
+		session->flags = flags;
+		session->blocks = blocks;
+		session->next = blocks;
+		session->lastSend = 0;
+	}
+	if (first >= session->blocks) {
+		return;
+	}
+	if (count > session->blocks - first) {
+		count = session->blocks - first;
+	}
+	if (first < session->next) {
+		session->next = first;
+	}
+	for (; count; first++, count--) {
+		session->pending[first / 8] |= 1 << (first % 8);
+	}
+	session->roundEnd = 0;
+}
+
+static void firmwareServerMulticastClose(firmwareServerSession_t *session)
+{
+	free(session->pending);
+	session->pending = NULL;
+}
+
+// Broadcast a block or the round end marker of the session
+static void firmwareServerMulticastSend(const firmwareServerSession_t *session, const uint16_t block,
+                                        const uint8_t *data)
+{
+	replyFirmwareBlockMulticast_t reply;
+	reply.type = session->type;
+	reply.version = session->version;
+	reply.block = block;
+	reply.flags = session->flags;
+	if (data) {
+		(void)memcpy(reply.data, data + block * FIRMWARE_BLOCK_SIZE, FIRMWARE_BLOCK_SIZE);
+	} else {
+		(void)memset(reply.data, 0xFF, FIRMWARE_BLOCK_SIZE);
+	}
+	(void)_sendRoute(build(_msgTmp, BROADCAST_ADDRESS, NODE_SENSOR_ID, C_STREAM, ST_FIRMWARE_RESPONSE,
+	                       false).set(&reply, sizeof(replyFirmwareBlockMulticast_t)));
+}
+
+void firmwareServerMulticast(void)
+{
+	const uint32_t now = hwMillis();
+	for (uint8_t i = 0; i < FIRMWARE_SERVER_SESSIONS; i++) {
+		firmwareServerSession_t *session = &_firmwareServerSessions[i];
+		if (!session->pending || now - session->lastSend < MY_OTA_MULTICAST_INTERVAL) {
+			continue;
+		}
+		// the image is looked up every time, it is freed when the directory is reloaded
+		uint16_t blocks = 0;
+		const uint8_t *data = firmwareServerData(session->type, session->version, session->flags, &blocks);
+		if (!data || blocks != session->blocks) {
+			firmwareServerMulticastClose(session);
+			continue;
+		}
+		while (session->next < session->blocks &&
+		        !(session->pending[session->next / 8] & (1 << (session->next % 8)))) {
+			session->next++;
+		}
+		if (session->next < session->blocks) {
+			const uint16_t block = session->next++;
+			session->pending[block / 8] &= ~(1 << (block % 8));
+			firmwareServerMulticastSend(session, block, data);
+			if (!(block % FIRMWARE_SERVER_PROGRESS_BLOCKS)) {
+				firmwareServerNotify("OTA MCAST,T=%d,B=%d", session->type, block);
+			}
+		} else if (!session->roundEnd) {
+			// the nodes report the blocks they missed
+			OTA_DEBUG(PSTR("OTA:MCS:ROUND END,T=%d\n"), session->type);
+			firmwareServerMulticastSend(session, FIRMWARE_MULTICAST_ROUND_END, NULL);
+			session->roundEnd = now | 1;
+		} else if (now - session->roundEnd > FIRMWARE_SERVER_SESSION_TIMEOUT) {
+			OTA_DEBUG(PSTR("OTA:MCS:CLOSE,T=%d\n"), session->type);
+			firmwareServerNotify("OTA MCAST END,T=%d,V=%d", session->type, session->version);
+			firmwareServerMulticastClose(session);
+			continue;
+		} else {
+			continue;
+		}
+		session->lastSend = now;
+	}
+}
+
+bool firmwareServerProcess(MyMessage &message)
+{
+	// copy the request, message may be overwritten while the reply is sent
+	const uint8_t sender = message.sender;
+	if (message.type == ST_FIRMWARE_CONFIG_REQUEST) {
+		requestFirmwareConfigTransfer_t request;
+		(void)memcpy(&request, message.data, sizeof(requestFirmwareConfigTransfer_t));
+		// nodes supporting compressed or patched firmware append a flag byte
+		const uint8_t supported = mGetLength(message) >= sizeof(requestFirmwareConfigTransfer_t) ? request.flags : 0;
+		firmwareServerRefresh();
+		firmwareServerImage_t *image = firmwareServerFind(request.request.type, false, 0);
+		if (!image) {
+			return false;
+		}
+		// pick the encoding with the fewest blocks
+		replyFirmwareConfigTransfer_t reply;
+		reply.config = image->config;
+		reply.transferBlocks = image->config.blocks;
+		reply.flags = 0;
+		if ((supported & FIRMWARE_FLAG_COMPRESSED) && image->compressed) {
+			reply.transferBlocks = image->compressedBlocks;
+			reply.flags = FIRMWARE_FLAG_COMPRESSED;
+		}
+		const bool update = memcmp(&request, &reply.config, sizeof(nodeFirmwareConfig_t));
+		const firmwareServerImage_t *base = firmwareServerFind(request.request.type, true,
+		                                    request.request.version);
+		if (update && (supported & FIRMWARE_FLAG_DELTA) && base && base != image &&
+		        base->config.crc == request.request.crc && base->config.blocks == request.request.blocks) {
+			const firmwareServerPatch_t *patch = firmwareServerPatch(image, base);
+			if (patch && patch->data && patch->blocks < reply.transferBlocks) {
+				reply.transferBlocks = patch->blocks;
+				reply.flags = FIRMWARE_FLAG_DELTA;
+			}
+		}
+		if (update && (supported & FIRMWARE_FLAG_MULTICAST) && !(reply.flags & FIRMWARE_FLAG_DELTA)) {
+			// join the multicast session of the firmware, all blocks are sent again for the new node
+			reply.flags |= FIRMWARE_FLAG_MULTICAST;
+			firmwareServerMulticastAdd(reply.config.type, reply.config.version, reply.flags,
+			                           reply.transferBlocks, 0, reply.transferBlocks);
+		}
+		if (update) {
+			OTA_DEBUG(PSTR("OTA:SRV:CFG,N=%d,T=%d,V=%d,F=%d,B=%d\n"), sender, reply.config.type,
+			          reply.config.version, reply.flags, reply.transferBlocks);
+			firmwareServerNotify("OTA START,N=%d,V=%d", sender, reply.config.version);
+		}
+		(void)_sendRoute(build(_msgTmp, sender, NODE_SENSOR_ID, C_STREAM, ST_FIRMWARE_CONFIG_RESPONSE,
+		                       false).set(&reply, reply.flags ? sizeof(replyFirmwareConfigTransfer_t) :
+		                                  sizeof(nodeFirmwareConfig_t)));
+		return true;
+	}
+	if (message.type == ST_FIRMWARE_REQUEST && mGetLength(message) >= offsetof(requestFirmwareNack_t, ranges) &&
+	        (((requestFirmwareNack_t *)message.data)->flags & FIRMWARE_FLAG_MULTICAST)) {
+		// NACK of a multicast node, broadcast the missing blocks again
+		requestFirmwareNack_t nack;
+		(void)memcpy(&nack, message.data, sizeof(requestFirmwareNack_t));
+		uint16_t blocks = 0;
+		if (!firmwareServerData(nack.type, nack.version, nack.flags, &blocks)) {
+			return false;
+		}
+		OTA_DEBUG(PSTR("OTA:SRV:NACK,N=%d,T=%d,M=%d\n"), sender, nack.type, nack.missing);
+		const uint8_t ranges = (mGetLength(message) - offsetof(requestFirmwareNack_t,
+		                        ranges)) / sizeof(firmwareRange_t);
+		for (uint8_t i = 0; i < ranges; i++) {
+			firmwareServerMulticastAdd(nack.type, nack.version, nack.flags, blocks, nack.ranges[i].first,
+			                           nack.ranges[i].count);
+		}
+		return true;
+	}
+	if (message.type == ST_FIRMWARE_REQUEST) {
+		requestFirmwareBlockTransfer_t request;
+		(void)memcpy(&request, message.data, sizeof(requestFirmwareBlockTransfer_t));
+		const uint8_t flags = mGetLength(message) >= sizeof(requestFirmwareBlockTransfer_t) ? request.flags : 0;
+		firmwareServerImage_t *image = firmwareServerFind(request.type, true, request.version);
+		if (!image) {
+			return false;
+		}
+		const uint8_t *data = image->data;
+		uint16_t blocks = image->config.blocks;
+		if (flags & FIRMWARE_FLAG_COMPRESSED) {
+			data = image->compressed;
+			blocks = image->compressedBlocks;
+		} else if (flags & FIRMWARE_FLAG_DELTA) {
+			const firmwareServerImage_t *base = firmwareServerFind(request.type, true, request.baseVersion);
+			const firmwareServerPatch_t *patch = base ? firmwareServerPatch(image, base) : NULL;
+			data = patch ? patch->data : NULL;
+			blocks = patch ? patch->blocks : 0;
+		}
+		if (!data || request.block >= blocks) {
+			return false;
+		}
+		replyFirmwareBlock_t reply;
+		reply.type = request.type;
+		reply.version = request.version;
+		reply.block = request.block;
+		(void)memcpy(reply.data, data + request.block * FIRMWARE_BLOCK_SIZE, FIRMWARE_BLOCK_SIZE);
+		// nodes request the blocks from the last to the first
+		if (!request.block) {
+			OTA_DEBUG(PSTR("OTA:SRV:END,N=%d\n"), sender);
+			firmwareServerNotify("OTA END,N=%d,V=%d", sender, request.version);
+		} else if (!(request.block % FIRMWARE_SERVER_PROGRESS_BLOCKS)) {
+			firmwareServerNotify("OTA BLOCK,N=%d,B=%d", sender, request.block);
+		}
+		(void)_sendRoute(build(_msgTmp, sender, NODE_SENSOR_ID, C_STREAM, ST_FIRMWARE_RESPONSE,
+		                       false).set(&reply, sizeof(replyFirmwareBlock_t)));
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,128 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+/**
+* @file MyOTAFirmwareServer.h
+*
+* @defgroup MyOTAFirmwareServergrp MyOTAFirmwareServer
+* @ingroup internals
+* @{
+*
+* The gateway answers firmware requests of the nodes from images stored in @ref MY_OTA_FIRMWARE_SERVER_DIR.
+* Images are named <type>-<version>.hex (Intel HEX) or <type>-<version>.bin (raw binary), with type and
+* version in decimal. A node is offered the highest version available for its firmware type. Requests the
+* gateway has no image for are forwarded to the controller as before.
+*
+* Images are read into memory on the first request and reloaded when the content of the directory changes.
+* They are compressed when loaded and sent compressed to nodes announcing support (@ref MY_OTA_COMPRESSION).
+* Nodes announcing patch support (@ref MY_OTA_DELTA) are sent a patch against their running firmware
+* instead, if its image is in the directory as well and the patch is the smallest of the options.
+* Nodes announcing multicast support (@ref MY_OTA_MULTICAST) share a session per firmware and encoding: its blocks are
+* broadcast once per round, every @ref MY_OTA_MULTICAST_INTERVAL ms, and a round end marker makes the nodes
+* report the blocks they missed, which are broadcast again in the next round.
+* The controller is informed of the progress with I_LOG_MESSAGE messages.
+*
+* MyOTAFirmwareServer-related log messages, format: [!]SYSTEM:[SUB SYSTEM:]MESSAGE
+* - [!] Exclamation mark is prepended in case of error or warning
+* - SYSTEM:
+*  - <b>OTA</b> messages emitted by MyOTAFirmwareServer
+* - SUB SYSTEMS:
+*  - OTA:<b>SRV</b>	from @ref firmwareServerProcess()
+*  - OTA:<b>MCS</b>	from @ref firmwareServerMulticast()
+*
+* MyOTAFirmwareServer debug log messages:
+*
+* |E| SYS	| SUB	| Message									| Comment
+* |-|------|-------|-------------------------------------------|----------------------------------------------------------------------------
+* | | OTA  | SRV	| LOAD,T=%d,V=%d,B=%d,C=%04X,Z=%d			| Image loaded, FW type (T), version (V), blocks (B), CRC (C), compressed blocks (Z)
+* |!| OTA  | SRV	| LOAD FAIL,%s								| Image file could not be loaded
+* | | OTA  | SRV	| CFG,N=%d,T=%d,V=%d,F=%d,B=%d				| FW config sent to node (N), FW type (T), version (V), transfer flags (F), blocks (B)
+* | | OTA  | SRV	| PATCH,T=%d,V=%d,BV=%d,B=%d				| Patch made, FW type (T), version (V), from version (BV), blocks (B)
+* | | OTA  | SRV	| END,N=%d									| Last FW block sent to node (N)
+* | | OTA  | SRV	| NACK,N=%d,T=%d,M=%d						| Multicast blocks missing reported by node (N), FW type (T), missing blocks (M)
+* | | OTA  | MCS	| ROUND END,T=%d							| Multicast round of FW type (T) ended
+* | | OTA  | MCS	| CLOSE,T=%d								| No blocks missing after the round end, session of FW type (T) closed
+* |!| OTA  | MCS	| NO SESSION,T=%d							| No free multicast session for FW type (T)
+*
+* @brief API declaration for MyOTAFirmwareServer
+*/
+
+#ifndef MyOTAFirmwareServer_h
+#define MyOTAFirmwareServer_h
+
+#include "MyOTAFirmwareUpdate.h"
+
+#define FIRMWARE_SERVER_PAGE_SIZE		(128u)	//!< Images are padded with 0xFF to a multiple of this size
+#define FIRMWARE_SERVER_MAX_SIZE		(FIRMWARE_BLOCK_SIZE * 0xFFFFul)	//!< Largest image that can be addressed by blocks
+#define FIRMWARE_SERVER_PROGRESS_BLOCKS	(128u)	//!< Report progress to the controller every this many blocks
+#define FIRMWARE_SERVER_LZ_CHAIN		(256u)	//!< Match candidates tried per position when compressing or patching
+#define FIRMWARE_SERVER_SESSIONS		(4u)	//!< Max. number of concurrent multicast sessions
+#define FIRMWARE_SERVER_SESSION_TIMEOUT	(3000ul)	//!< Multicast session is closed if no NACK arrives this long after the round end
+
+/**
+* @brief Patch of an image against an older version, see @ref replyFirmwareConfigTransfer_t
+*/
+typedef struct firmwareServerPatch {
+	uint16_t baseVersion;						//!< Version the patch applies to
+	uint16_t blocks;							//!< Number of blocks of the patch
+	uint8_t *data;								//!< Patch data, NULL if patching does not save blocks
+	struct firmwareServerPatch *next;			//!< Next patch of the image
+} firmwareServerPatch_t;
+
+/**
+* @brief Firmware image held in memory
+*/
+typedef struct {
+	nodeFirmwareConfig_t config;				//!< Type, version, blocks and CRC of the image
+	uint8_t *data;								//!< Image data, config.blocks * FIRMWARE_BLOCK_SIZE bytes
+	uint8_t *compressed;						//!< Compressed image data, NULL if compression does not save blocks
+	uint16_t compressedBlocks;					//!< Number of blocks of the compressed image
+	firmwareServerPatch_t *patches;				//!< Patches against older versions, made when first requested
+} firmwareServerImage_t;
+
+/**
+* @brief Multicast session, shared by all nodes updating to the same firmware with the same encoding
+*/
+typedef struct {
+	uint16_t type;								//!< FW type
+	uint16_t version;							//!< FW version
+	uint8_t flags;								//!< Transfer flags, FIRMWARE_FLAG_MULTICAST and the encoding
+	uint16_t blocks;							//!< Number of blocks sent
+	uint8_t *pending;							//!< Bitmap of the blocks to broadcast, NULL if the session is unused
+	uint16_t next;								//!< Lowest block that may be pending
+	uint32_t lastSend;							//!< Time of the last broadcast
+	uint32_t roundEnd;							//!< Time the round end was broadcast, 0 while blocks are pending
+} firmwareServerSession_t;
+
+/**
+ * @brief Answer firmware config and block requests of a node from the image cache
+ *
+ * @param message C_STREAM message addressed to the gateway
+ * @return true if the request has been answered, false if it should be forwarded to the controller
+ */
+bool firmwareServerProcess(MyMessage &message);
+
+/**
+ * @brief Broadcast the next pending block of the multicast sessions, called from _process()
+ */
+void firmwareServerMulticast(void);
+
+#endif
+
+/** @}*/
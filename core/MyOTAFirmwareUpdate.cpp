@@ -20,7 +20,6 @@
 #include "MyOTAFirmwareUpdate.h"
 
 // global variables
-extern MyMessage _msg;
 extern MyMessage _msgTmp;
 
 // local variables
@@ -28,19 +27,393 @@ SPIFlash _flash(MY_OTA_FLASH_SS, MY_OTA_FLASH_JDECID);
 nodeFirmwareConfig_t _nodeFirmwareConfig;
 bool _firmwareUpdateOngoing;
 uint32_t _firmwareLastRequest;
-uint16_t _firmwareBlock;
+uint16_t _firmwareBlock;		// All blocks from _firmwareBlock and up have been received
+uint32_t _firmwareReceived;		// Window bitmap, bit n set if block _firmwareBlock-1-n has been received
+uint32_t _firmwareRequested;	// Window bitmap, bit n set if block _firmwareBlock-1-n has been requested
 uint8_t _firmwareRetry;
+uint64_t _firmwareErase;			// Bitmap of the flash sectors still to be erased before use, bit n for sector n
+#if defined(MY_OTA_TRANSFER_ENCODING)
+uint8_t _firmwareTransfer;			// FIRMWARE_FLAG_*, 0 if the firmware is sent as is and requested block by block
+uint16_t _firmwareTransferBlocks;	// Number of blocks of the compressed firmware or patch
+#endif
+#if defined(MY_OTA_MULTICAST)
+uint16_t _firmwareMissing;			// Number of blocks still missing in a multicast transfer
+#endif
+#if defined(MY_OTA_DELTA)
+nodeFirmwareConfig_t _firmwareRunning;	// Config of the running firmware, the base of a patch
+bool _firmwareRunningValid;			// Running firmware matches _firmwareRunning
+#endif
+
+static_assert(FIRMWARE_START_OFFSET + FIRMWARE_MAX_SIZE <= FIRMWARE_TRANSFER_OFFSET,
+              "OTA image and transfer areas overlap");
+static_assert(FIRMWARE_TRANSFER_OFFSET + FIRMWARE_MAX_SIZE <= FIRMWARE_MULTICAST_BITMAP_OFFSET,
+              "OTA transfer area and multicast bitmap overlap");
+static_assert((FIRMWARE_MULTICAST_BITMAP_OFFSET + (FIRMWARE_MAX_SIZE / FIRMWARE_BLOCK_SIZE + 7) / 8 - 1) /
+              FIRMWARE_SECTOR_SIZE < FIRMWARE_ERASE_SECTORS,
+              "OTA flash areas exceed the sectors erased in the background");
+static_assert(FIRMWARE_ERASE_SECTORS <= 64, "FIRMWARE_ERASE_SECTORS exceeds the erase bitmap");
+static_assert(sizeof(replyFirmwareBlockMulticast_t) <= MAX_PAYLOAD,
+              "OTA multicast block exceeds the message payload");
+
+// Number of blocks in the transfer window, less than MY_OTA_WINDOW_SIZE for the last blocks
+static uint8_t firmwareWindowSize(void)
+{
+	return _firmwareBlock < MY_OTA_WINDOW_SIZE ? _firmwareBlock : MY_OTA_WINDOW_SIZE;
+}
+
+// Flash address of a received block
+static uint32_t firmwareBlockAddress(const uint16_t block)
+{
+#if defined(MY_OTA_TRANSFER_ENCODING)
+	if (_firmwareTransfer & (FIRMWARE_FLAG_COMPRESSED | FIRMWARE_FLAG_DELTA)) {
+		return FIRMWARE_TRANSFER_OFFSET + (uint32_t)block * FIRMWARE_BLOCK_SIZE;
+	}
+#endif
+	return (uint32_t)block * FIRMWARE_BLOCK_SIZE + FIRMWARE_START_OFFSET;
+}
+
+// Erase a flash area before use, the sectors are erased in the background by firmwareEraseProcess()
+// or on first access by firmwareEraseBefore()
+static void firmwareEraseSchedule(const uint32_t address, const uint32_t length)
+{
+	for (uint32_t sector = address / FIRMWARE_SECTOR_SIZE;
+	        sector <= (address + length - 1) / FIRMWARE_SECTOR_SIZE; sector++) {
+		if (sector < FIRMWARE_ERASE_SECTORS) {
+			_firmwareErase |= (uint64_t)1 << sector;
+		} else {
+			_flash.blockErase4K(sector * FIRMWARE_SECTOR_SIZE);
+		}
+	}
+}
+
+// Erase the sectors of a flash area still pending, before it is read or written
+static void firmwareEraseBefore(const uint32_t address, const uint16_t length)
+{
+	for (uint32_t sector = address / FIRMWARE_SECTOR_SIZE;
+	        sector <= (address + length - 1) / FIRMWARE_SECTOR_SIZE && sector < FIRMWARE_ERASE_SECTORS;
+	        sector++) {
+		if (_firmwareErase & ((uint64_t)1 << sector)) {
+			_firmwareErase &= ~((uint64_t)1 << sector);
+			_flash.blockErase4K(sector * FIRMWARE_SECTOR_SIZE);
+		}
+	}
+}
+
+// Start erasing a pending sector while the flash is idle, the highest first as blocks are requested
+// from the last to the first. The erase runs while the node waits for the radio, the next flash
+// command waits for it to complete.
+static void firmwareEraseProcess(void)
+{
+	if (!_firmwareErase || _flash.busy()) {
+		return;
+	}
+	uint8_t sector = FIRMWARE_ERASE_SECTORS - 1;
+	while (!(_firmwareErase & ((uint64_t)1 << sector))) {
+		sector--;
+	}
+	_firmwareErase &= ~((uint64_t)1 << sector);
+	_flash.blockErase4K(sector * FIRMWARE_SECTOR_SIZE);
+}
+
+// Write a FW block, programming runs in the background until the next flash command
+static void firmwareWriteBlock(const uint32_t address, const uint8_t *data)
+{
+	firmwareEraseBefore(address, FIRMWARE_BLOCK_SIZE);
+	_flash.writeBytes(address, data, FIRMWARE_BLOCK_SIZE);
+}
+
+// crc16 (polynomial 0xA001) of the low nibble, shifted out
+static const uint16_t _firmwareCrcTable[16] PROGMEM = {
+	0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+	0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+
+// crc16 step of the firmware checksum, one table lookup per nibble
+static uint16_t firmwareCrc(uint16_t crc, const uint8_t data)
+{
+	crc ^= data;
+	crc = (crc >> 4) ^ pgm_read_word(&_firmwareCrcTable[crc & 0x0F]);
+	crc = (crc >> 4) ^ pgm_read_word(&_firmwareCrcTable[crc & 0x0F]);
+	return crc;
+}
+
+#if defined(MY_OTA_TRANSFER_ENCODING)
+// Output of the firmware decoders, written to flash one block at a time
+typedef struct {
+	uint32_t position;						// Number of bytes written
+	uint8_t buffer[FIRMWARE_BLOCK_SIZE];	// Bytes of the block not yet written to flash
+} firmwareWriter_t;
+
+static void firmwareWrite(firmwareWriter_t *writer, const uint8_t data)
+{
+	writer->buffer[writer->position % FIRMWARE_BLOCK_SIZE] = data;
+	if (!(++writer->position % FIRMWARE_BLOCK_SIZE)) {
+		firmwareWriteBlock(FIRMWARE_START_OFFSET + writer->position - FIRMWARE_BLOCK_SIZE, writer->buffer);
+	}
+}
+
+static uint8_t firmwareReadTransfer(const uint32_t position)
+{
+	return _flash.readByte(FIRMWARE_TRANSFER_OFFSET + position);
+}
+#endif
+
+#if defined(MY_OTA_COMPRESSION)
+// Byte already written by the decoder, from flash or the block buffer
+static uint8_t firmwareReadWritten(const firmwareWriter_t *writer, const uint32_t position)
+{
+	if (position >= writer->position - writer->position % FIRMWARE_BLOCK_SIZE) {
+		return writer->buffer[position % FIRMWARE_BLOCK_SIZE];
+	}
+	return _flash.readByte(FIRMWARE_START_OFFSET + position);
+}
+
+// Decompress the firmware received to FIRMWARE_TRANSFER_OFFSET into place at FIRMWARE_START_OFFSET.
+// Back-references are read from the output already in flash, only one block is buffered in RAM.
+static bool firmwareDecompress(void)
+{
+	const uint32_t inputSize = (uint32_t)_firmwareTransferBlocks * FIRMWARE_BLOCK_SIZE;
+	const uint32_t outputSize = (uint32_t)_nodeFirmwareConfig.blocks * FIRMWARE_BLOCK_SIZE;
+	firmwareWriter_t writer;
+	writer.position = 0;
+	uint32_t input = 0;
+	uint8_t flags = 0;
+	uint8_t items = 0;
+	while (writer.position < outputSize) {
+		if (!items) {
+			if (input >= inputSize) {
+				return false;
+			}
+			flags = firmwareReadTransfer(input++);
+			items = 8;
+		}
+		if (flags & 1) {
+			if (input + 2 > inputSize) {
+				return false;
+			}
+			const uint8_t high = firmwareReadTransfer(input++);
+			const uint8_t low = firmwareReadTransfer(input++);
+			const uint16_t distance = (((uint16_t)high << 4) | (low >> 4)) + 1;
+			uint8_t length = (low & 0x0F) + FIRMWARE_LZ_MIN_MATCH;
+			if (distance > writer.position) {
+				return false;
+			}
+			while (length-- && writer.position < outputSize) {
+				firmwareWrite(&writer, firmwareReadWritten(&writer, writer.position - distance));
+			}
+		} else {
+			if (input >= inputSize) {
+				return false;
+			}
+			firmwareWrite(&writer, firmwareReadTransfer(input++));
+		}
+		flags >>= 1;
+		items--;
+	}
+	return true;
+}
+#endif
+
+#if defined(MY_OTA_DELTA)
+// Byte of the running firmware in program memory
+static uint8_t firmwareReadRunning(const uint32_t address)
+{
+#if FLASHEND > 0xFFFF
+	return pgm_read_byte_far(address);
+#else
+	return pgm_read_byte(address);
+#endif
+}
+
+// Check that the program memory holds the firmware described by the config in eeprom
+static bool firmwareRunningIsValid(void)
+{
+	const uint32_t size = (uint32_t)_firmwareRunning.blocks * FIRMWARE_BLOCK_SIZE;
+	if (!size || size > (uint32_t)FLASHEND + 1) {
+		return false;
+	}
+	uint16_t crc = ~0;
+	for (uint32_t i = 0; i < size; ++i) {
+		crc = firmwareCrc(crc, firmwareReadRunning(i));
+	}
+	return crc == _firmwareRunning.crc;
+}
+
+// Rebuild the new firmware at FIRMWARE_START_OFFSET from the patch received to FIRMWARE_TRANSFER_OFFSET
+// and the running firmware
+static bool firmwareApplyDelta(void)
+{
+	const uint32_t inputSize = (uint32_t)_firmwareTransferBlocks * FIRMWARE_BLOCK_SIZE;
+	const uint32_t outputSize = (uint32_t)_nodeFirmwareConfig.blocks * FIRMWARE_BLOCK_SIZE;
+	const uint32_t baseSize = (uint32_t)_firmwareRunning.blocks * FIRMWARE_BLOCK_SIZE;
+	firmwareWriter_t writer;
+	writer.position = 0;
+	uint32_t input = 0;
+	while (writer.position < outputSize) {
+		if (input >= inputSize) {
+			return false;
+		}
+		const uint8_t command = firmwareReadTransfer(input++);
+		if (command < 0x80) {
+			// literal bytes
+			for (uint8_t i = 0; i <= command && writer.position < outputSize; i++) {
+				if (input >= inputSize) {
+					return false;
+				}
+				firmwareWrite(&writer, firmwareReadTransfer(input++));
+			}
+		} else {
+			// copy from the running firmware, relative to the output position
+			if (input + 2 > inputSize) {
+				return false;
+			}
+			const int16_t offset = (int16_t)(firmwareReadTransfer(input) | ((uint16_t)firmwareReadTransfer(
+			                                     input + 1) << 8));
+			input += 2;
+			uint8_t length = (command & 0x7F) + FIRMWARE_DELTA_MIN_COPY;
+			uint32_t source = writer.position + offset;
+			if ((int32_t)writer.position + offset < 0 || source + length > baseSize) {
+				return false;
+			}
+			while (length-- && writer.position < outputSize) {
+				firmwareWrite(&writer, firmwareReadRunning(source++));
+			}
+		}
+	}
+	return true;
+}
+#endif
+
+// Decode and verify the received firmware, reboot into it if valid
+static void firmwareFinish(void)
+{
+	// We're finished! Do a checksum and reboot.
+	OTA_DEBUG(PSTR("OTA:FWP:FW END\n"));	// received FW block
+	_firmwareUpdateOngoing = false;
+#if defined(MY_OTA_COMPRESSION)
+	if ((_firmwareTransfer & FIRMWARE_FLAG_COMPRESSED) && !firmwareDecompress()) {
+		OTA_DEBUG(PSTR("!OTA:FWP:DECOMPRESS FAIL\n"));
+	}
+#endif
+#if defined(MY_OTA_DELTA)
+	if ((_firmwareTransfer & FIRMWARE_FLAG_DELTA) && !firmwareApplyDelta()) {
+		OTA_DEBUG(PSTR("!OTA:FWP:PATCH FAIL\n"));
+	}
+#endif
+	if (transportIsValidFirmware()) {
+		OTA_DEBUG(PSTR("OTA:FWP:CRC OK\n"));	// FW checksum ok
+		// Write the new firmware config to eeprom
+		hwWriteConfigBlock((void*)&_nodeFirmwareConfig, (void*)EEPROM_FIRMWARE_TYPE_ADDRESS,
+		                   sizeof(nodeFirmwareConfig_t));
+		// All seems ok, write size and signature to flash (DualOptiboot will pick this up and flash it)
+		const uint32_t firmwareSize = (uint32_t)FIRMWARE_BLOCK_SIZE * _nodeFirmwareConfig.blocks;
+		const uint8_t OTAbuffer[FIRMWARE_START_OFFSET] = {'F','L','X','I','M','G',':', (uint8_t)(firmwareSize >> 8), (uint8_t)(firmwareSize & 0xff),':'};
+		firmwareEraseBefore(0, FIRMWARE_START_OFFSET);
+		_flash.writeBytes(0, OTAbuffer, FIRMWARE_START_OFFSET);
+		// wait until flash ready
+		while (_flash.busy()) {}
+		hwReboot();
+	} else {
+		setIndication(INDICATION_ERR_FW_CHECKSUM);
+		OTA_DEBUG(PSTR("!OTA:FWP:CRC FAIL\n"));
+	}
+}
+
+#if defined(MY_OTA_MULTICAST)
+// The bitmap in flash has a bit set for every block still missing, receiving a block clears it without erase
+static bool firmwareMulticastIsMissing(const uint16_t block)
+{
+	firmwareEraseBefore(FIRMWARE_MULTICAST_BITMAP_OFFSET + block / 8, 1);
+	return _flash.readByte(FIRMWARE_MULTICAST_BITMAP_OFFSET + block / 8) & (1 << (block % 8));
+}
+
+static void firmwareMulticastSetReceived(const uint16_t block)
+{
+	const uint32_t address = FIRMWARE_MULTICAST_BITMAP_OFFSET + block / 8;
+	_flash.writeByte(address, _flash.readByte(address) & ~(1 << (block % 8)));
+}
+
+// Report the missing blocks to the gateway, which broadcasts them again
+static void firmwareMulticastNack(void)
+{
+	requestFirmwareNack_t nack;
+	nack.type = _nodeFirmwareConfig.type;
+	nack.version = _nodeFirmwareConfig.version;
+	nack.missing = _firmwareMissing;
+	nack.flags = _firmwareTransfer;
+	uint8_t ranges = 0;
+	for (uint16_t block = 0; block < _firmwareTransferBlocks; block++) {
+		if (!firmwareMulticastIsMissing(block)) {
+			continue;
+		}
+		if (ranges && nack.ranges[ranges - 1].first + nack.ranges[ranges - 1].count == block) {
+			nack.ranges[ranges - 1].count++;
+			continue;
+		}
+		if (ranges == FIRMWARE_NACK_RANGES) {
+			break;
+		}
+		nack.ranges[ranges].first = block;
+		nack.ranges[ranges].count = 1;
+		ranges++;
+	}
+	OTA_DEBUG(PSTR("OTA:FRQ:FW NACK,M=%04X,R=%d\n"), _firmwareMissing, ranges);
+	(void)_sendRoute(build(_msgTmp, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_STREAM, ST_FIRMWARE_REQUEST,
+	                       false).set(&nack, sizeof(requestFirmwareNack_t) - (FIRMWARE_NACK_RANGES - ranges) *
+	                                  sizeof(firmwareRange_t)));
+}
+
+// Store a broadcast block if it is still missing
+static void firmwareMulticastProcess(const replyFirmwareBlockMulticast_t *firmwareResponse)
+{
+	// blocks of a session of the same firmware in another encoding are ignored
+	if (firmwareResponse->type != _nodeFirmwareConfig.type ||
+	        firmwareResponse->version != _nodeFirmwareConfig.version ||
+	        firmwareResponse->flags != _firmwareTransfer) {
+		return;
+	}
+	// any block of the session shows the gateway is still sending
+	_firmwareRetry = MY_OTA_RETRY;
+	_firmwareLastRequest = hwMillis();
+	const uint16_t block = firmwareResponse->block;
+	if (block == FIRMWARE_MULTICAST_ROUND_END) {
+		// Report the missing blocks after a random delay, to spread the NACKs of all nodes
+		OTA_DEBUG(PSTR("OTA:FWP:ROUND END,M=%04X\n"), _firmwareMissing);
+		_firmwareLastRequest -= MY_OTA_RETRY_DELAY - hwMillis() % MY_OTA_RETRY_DELAY;
+		return;
+	}
+	if (block >= _firmwareTransferBlocks || !firmwareMulticastIsMissing(block)) {
+		OTA_DEBUG(PSTR("OTA:FWP:SKIP B=%04X\n"), block);	// duplicate or unexpected FW block
+		return;
+	}
+	setIndication(INDICATION_FW_UPDATE_RX);
+	OTA_DEBUG(PSTR("OTA:FWP:RECV B=%04X\n"), block);	// received FW block
+	firmwareWriteBlock(firmwareBlockAddress(block), firmwareResponse->data);
+	firmwareMulticastSetReceived(block);
+	if (!--_firmwareMissing) {
+		firmwareFinish();
+	}
+}
+#endif
 
 void readFirmwareSettings(void)
 {
 	hwReadConfigBlock((void*)&_nodeFirmwareConfig, (void*)EEPROM_FIRMWARE_TYPE_ADDRESS,
 	                  sizeof(nodeFirmwareConfig_t));
+#if defined(MY_OTA_DELTA)
+	_firmwareRunning = _nodeFirmwareConfig;
+	_firmwareRunningValid = firmwareRunningIsValid();
+#endif
 }
 
 void firmwareOTAUpdateRequest(void)
 {
+	if (!_firmwareUpdateOngoing) {
+		return;
+	}
+	firmwareEraseProcess();
 	const uint32_t enterMS = hwMillis();
-	if (_firmwareUpdateOngoing && (enterMS - _firmwareLastRequest > MY_OTA_RETRY_DELAY)) {
+	if (enterMS - _firmwareLastRequest > MY_OTA_RETRY_DELAY) {
 		if (!_firmwareRetry) {
 			setIndication(INDICATION_ERR_FW_TIMEOUT);
 			OTA_DEBUG(PSTR("!OTA:FRQ:FW UPD FAIL\n"));	// fw update failed
@@ -49,25 +422,72 @@ void firmwareOTAUpdateRequest(void)
 			return;
 		}
 		_firmwareRetry--;
+#if defined(MY_OTA_MULTICAST)
+		if (_firmwareTransfer & FIRMWARE_FLAG_MULTICAST) {
+			_firmwareLastRequest = enterMS;
+			firmwareMulticastNack();
+			return;
+		}
+#endif
+		// Time to re-request the blocks of the window that did not arrive
+		_firmwareRequested = _firmwareReceived;
+	}
+#if defined(MY_OTA_MULTICAST)
+	if (_firmwareTransfer & FIRMWARE_FLAG_MULTICAST) {
+		return;	// blocks are broadcast by the gateway without requests
+	}
+#endif
+	// Keep a request outstanding for every block of the window
+	const uint8_t window = firmwareWindowSize();
+	for (uint8_t i = 0; i < window; i++) {
+		if (_firmwareRequested & ((uint32_t)1 << i)) {
+			continue;
+		}
+		_firmwareRequested |= (uint32_t)1 << i;
 		_firmwareLastRequest = enterMS;
-		// Time to (re-)request firmware block from controller
 		requestFirmwareBlock_t firmwareRequest;
 		firmwareRequest.type = _nodeFirmwareConfig.type;
 		firmwareRequest.version = _nodeFirmwareConfig.version;
-		firmwareRequest.block = (_firmwareBlock - 1);
+		firmwareRequest.block = _firmwareBlock - 1 - i;
 		OTA_DEBUG(PSTR("OTA:FRQ:FW REQ,T=%04X,V=%04X,B=%04X\n"), _nodeFirmwareConfig.type,
-		          _nodeFirmwareConfig.version, _firmwareBlock - 1); // request FW update block
-		(void)_sendRoute(build(_msgTmp, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_STREAM, ST_FIRMWARE_REQUEST,
-		                       false).set(&firmwareRequest, sizeof(requestFirmwareBlock_t)));
+		          _nodeFirmwareConfig.version, firmwareRequest.block); // request FW update block
+		build(_msgTmp, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_STREAM, ST_FIRMWARE_REQUEST,
+		      false).set(&firmwareRequest, sizeof(requestFirmwareBlock_t));
+#if defined(MY_OTA_TRANSFER_ENCODING)
+		if (_firmwareTransfer) {
+			// request the block of the compressed firmware or patch
+			requestFirmwareBlockTransfer_t *transferRequest = (requestFirmwareBlockTransfer_t *)_msgTmp.data;
+			transferRequest->flags = _firmwareTransfer;
+#if defined(MY_OTA_DELTA)
+			transferRequest->baseVersion = _firmwareRunning.version;
+#else
+			transferRequest->baseVersion = 0;
+#endif
+			mSetLength(_msgTmp, sizeof(requestFirmwareBlockTransfer_t));
+		}
+#endif
+		(void)_sendRoute(_msgTmp);
 	}
 }
 
-bool firmwareOTAUpdateProcess(void)
+bool firmwareOTAUpdateProcess(MyMessage &message)
 {
-	if (_msg.type == ST_FIRMWARE_CONFIG_RESPONSE) {
-		nodeFirmwareConfig_t *firmwareConfigResponse = (nodeFirmwareConfig_t *)_msg.data;
+	if (message.type == ST_FIRMWARE_CONFIG_RESPONSE) {
+		nodeFirmwareConfig_t *firmwareConfigResponse = (nodeFirmwareConfig_t *)message.data;
 		// compare with current node configuration, if they differ, start FW fetch process
 		if (memcmp(&_nodeFirmwareConfig, firmwareConfigResponse, sizeof(nodeFirmwareConfig_t))) {
+			// the image, and a compressed firmware or patch, must fit their flash areas
+			uint16_t blocks = firmwareConfigResponse->blocks;
+#if defined(MY_OTA_TRANSFER_ENCODING)
+			if (mGetLength(message) >= sizeof(replyFirmwareConfigTransfer_t) &&
+			        ((replyFirmwareConfigTransfer_t *)message.data)->transferBlocks > blocks) {
+				blocks = ((replyFirmwareConfigTransfer_t *)message.data)->transferBlocks;
+			}
+#endif
+			if ((uint32_t)blocks * FIRMWARE_BLOCK_SIZE > FIRMWARE_MAX_SIZE) {
+				OTA_DEBUG(PSTR("!OTA:FWP:SIZE B=%04X\n"), blocks);	// FW too large for the target
+				return true;
+			}
 			setIndication(INDICATION_FW_UPDATE_START);
 			OTA_DEBUG(PSTR("OTA:FWP:UPDATE\n"));	// FW update initiated
 			// copy new FW config
@@ -78,56 +498,85 @@ bool firmwareOTAUpdateProcess(void)
 				OTA_DEBUG(PSTR("!OTA:FWP:FLASH INIT FAIL\n"));	// failed to initialise flash
 				_firmwareUpdateOngoing = false;
 			} else {
-				// erase lower 32K -> max flash size for ATMEGA328
-				_flash.blockErase32K(0);
-				// wait until flash erased
-				while ( _flash.busy() ) {}
+				// erase the sectors of the image only, in the background
+				_firmwareErase = 0;
+				firmwareEraseSchedule(0, FIRMWARE_START_OFFSET + (uint32_t)_nodeFirmwareConfig.blocks *
+				                      FIRMWARE_BLOCK_SIZE);
 				_firmwareBlock = _nodeFirmwareConfig.blocks;
+#if defined(MY_OTA_TRANSFER_ENCODING)
+				_firmwareTransfer = 0;
+				if (mGetLength(message) >= sizeof(replyFirmwareConfigTransfer_t)) {
+					// compressed firmware, patch or multicast
+					const replyFirmwareConfigTransfer_t *transfer = (replyFirmwareConfigTransfer_t *)message.data;
+					_firmwareTransfer = transfer->flags;
+					_firmwareTransferBlocks = transfer->transferBlocks;
+					_firmwareBlock = _firmwareTransferBlocks;
+					OTA_DEBUG(PSTR("OTA:FWP:TRANSFER F=%02X,B=%04X\n"), _firmwareTransfer, _firmwareTransferBlocks);
+					if (_firmwareTransfer & (FIRMWARE_FLAG_COMPRESSED | FIRMWARE_FLAG_DELTA)) {
+						// erase the area it is received to
+						firmwareEraseSchedule(FIRMWARE_TRANSFER_OFFSET, (uint32_t)_firmwareTransferBlocks * FIRMWARE_BLOCK_SIZE);
+					}
+#if defined(MY_OTA_MULTICAST)
+					if (_firmwareTransfer & FIRMWARE_FLAG_MULTICAST) {
+						// erase the bitmap, all blocks missing
+						firmwareEraseSchedule(FIRMWARE_MULTICAST_BITMAP_OFFSET, ((uint32_t)_firmwareTransferBlocks + 7) / 8);
+						_firmwareMissing = _firmwareTransferBlocks;
+					}
+#endif
+				}
+#endif
+				_firmwareReceived = 0;
+				_firmwareRequested = 0;
 				_firmwareUpdateOngoing = true;
 				// reset flags
-				_firmwareRetry = MY_OTA_RETRY + 1;
-				_firmwareLastRequest = 0;
+				_firmwareRetry = MY_OTA_RETRY;
+				_firmwareLastRequest = hwMillis();
 			}
 			return true;
 		}
 		OTA_DEBUG(PSTR("OTA:FWP:UPDATE SKIPPED\n"));		// FW update skipped, no newer version available
-	} else if (_msg.type == ST_FIRMWARE_RESPONSE) {
+	} else if (message.type == ST_FIRMWARE_RESPONSE) {
 		if (_firmwareUpdateOngoing) {
+			// extract FW block
+			replyFirmwareBlock_t *firmwareResponse = (replyFirmwareBlock_t *)message.data;
+#if defined(MY_OTA_MULTICAST)
+			if (_firmwareTransfer & FIRMWARE_FLAG_MULTICAST) {
+				if (mGetLength(message) == sizeof(replyFirmwareBlockMulticast_t)) {
+					firmwareMulticastProcess((const replyFirmwareBlockMulticast_t *)message.data);
+				}
+				return true;
+			}
+			if (message.destination == BROADCAST_ADDRESS) {
+				return true;	// block of a multicast transfer this node is not part of
+			}
+#endif
+			const uint16_t block = firmwareResponse->block;
+			// Blocks arrive in any order, only blocks still missing in the window are stored
+			const uint16_t position = _firmwareBlock - 1 - block;
+			if (firmwareResponse->type != _nodeFirmwareConfig.type ||
+			        firmwareResponse->version != _nodeFirmwareConfig.version || block >= _firmwareBlock ||
+			        position >= firmwareWindowSize() || (_firmwareReceived & ((uint32_t)1 << position))) {
+				OTA_DEBUG(PSTR("OTA:FWP:SKIP B=%04X\n"), block);	// duplicate or unexpected FW block
+				return true;
+			}
 			// Save block to flash
 			setIndication(INDICATION_FW_UPDATE_RX);
-			OTA_DEBUG(PSTR("OTA:FWP:RECV B=%04X\n"), _firmwareBlock);	// received FW block
-			// extract FW block
-			replyFirmwareBlock_t *firmwareResponse = (replyFirmwareBlock_t *)_msg.data;
+			OTA_DEBUG(PSTR("OTA:FWP:RECV B=%04X\n"), block);	// received FW block
 			// write to flash
-			_flash.writeBytes( ((_firmwareBlock - 1) * FIRMWARE_BLOCK_SIZE) + FIRMWARE_START_OFFSET,
-			                   firmwareResponse->data, FIRMWARE_BLOCK_SIZE);
-			// wait until flash written
-			while (_flash.busy()) {}
-			_firmwareBlock--;
+			firmwareWriteBlock(firmwareBlockAddress(block), firmwareResponse->data);
+			_firmwareReceived |= (uint32_t)1 << position;
+			// Slide the window past the blocks received without gaps
+			while (_firmwareReceived & 1) {
+				_firmwareReceived >>= 1;
+				_firmwareRequested >>= 1;
+				_firmwareBlock--;
+			}
 			if (!_firmwareBlock) {
-				// We're finished! Do a checksum and reboot.
-				OTA_DEBUG(PSTR("OTA:FWP:FW END\n"));	// received FW block
-				_firmwareUpdateOngoing = false;
-				if (transportIsValidFirmware()) {
-					OTA_DEBUG(PSTR("OTA:FWP:CRC OK\n"));	// FW checksum ok
-					// Write the new firmware config to eeprom
-					hwWriteConfigBlock((void*)&_nodeFirmwareConfig, (void*)EEPROM_FIRMWARE_TYPE_ADDRESS,
-					                   sizeof(nodeFirmwareConfig_t));
-					// All seems ok, write size and signature to flash (DualOptiboot will pick this up and flash it)
-					const uint16_t firmwareSize = FIRMWARE_BLOCK_SIZE * _nodeFirmwareConfig.blocks;
-					const uint8_t OTAbuffer[FIRMWARE_START_OFFSET] = {'F','L','X','I','M','G',':', (uint8_t)(firmwareSize >> 8), (uint8_t)(firmwareSize & 0xff),':'};
-					_flash.writeBytes(0, OTAbuffer, FIRMWARE_START_OFFSET);
-					// wait until flash ready
-					while (_flash.busy()) {}
-					hwReboot();
-				} else {
-					setIndication(INDICATION_ERR_FW_CHECKSUM);
-					OTA_DEBUG(PSTR("!OTA:FWP:CRC FAIL\n"));
-				}
+				firmwareFinish();
 			}
-			// reset flags
-			_firmwareRetry = MY_OTA_RETRY + 1;
-			_firmwareLastRequest = 0;
+			// reset flags, progress was made
+			_firmwareRetry = MY_OTA_RETRY;
+			_firmwareLastRequest = hwMillis();
 		} else {
 			OTA_DEBUG(PSTR("!OTA:FWP:NO UPDATE\n"));
 		}
@@ -147,8 +596,25 @@ void presentBootloaderInformation(void)
 	// add bootloader information
 	requestFirmwareConfig->BLVersion = MY_OTA_BOOTLOADER_VERSION;
 	_firmwareUpdateOngoing = false;
-	(void)_sendRoute(build(_msgTmp, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_STREAM,
-	                       ST_FIRMWARE_CONFIG_REQUEST, false));
+	build(_msgTmp, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_STREAM, ST_FIRMWARE_CONFIG_REQUEST, false);
+#if defined(MY_OTA_TRANSFER_ENCODING)
+	// announce the supported transfer encodings
+	requestFirmwareConfigTransfer_t *transferRequest = (requestFirmwareConfigTransfer_t *)_msgTmp.data;
+	transferRequest->flags = 0;
+#if defined(MY_OTA_COMPRESSION)
+	transferRequest->flags |= FIRMWARE_FLAG_COMPRESSED;
+#endif
+#if defined(MY_OTA_DELTA)
+	if (_firmwareRunningValid) {
+		transferRequest->flags |= FIRMWARE_FLAG_DELTA;
+	}
+#endif
+#if defined(MY_OTA_MULTICAST)
+	transferRequest->flags |= FIRMWARE_FLAG_MULTICAST;
+#endif
+	mSetLength(_msgTmp, sizeof(requestFirmwareConfigTransfer_t));
+#endif
+	(void)_sendRoute(_msgTmp);
 }
 bool isFirmwareUpdateOngoing(void)
 {
@@ -159,14 +625,14 @@ bool transportIsValidFirmware(void)
 {
 	// init crc
 	uint16_t crc = ~0;
-	for (uint16_t i = 0; i < _nodeFirmwareConfig.blocks * FIRMWARE_BLOCK_SIZE; ++i) {
-		crc ^= _flash.readByte(i + FIRMWARE_START_OFFSET);
-		for (int8_t j = 0; j < 8; ++j) {
-			if (crc & 1) {
-				crc = (crc >> 1) ^ 0xA001;
-			} else {
-				crc = (crc >> 1);
-			}
+	// read the flash in chunks, every transaction costs a status poll and a command with address
+	uint8_t buffer[FIRMWARE_CRC_CHUNK_SIZE];
+	const uint32_t size = (uint32_t)_nodeFirmwareConfig.blocks * FIRMWARE_BLOCK_SIZE;
+	for (uint32_t i = 0; i < size; i += FIRMWARE_CRC_CHUNK_SIZE) {
+		const uint16_t length = size - i < FIRMWARE_CRC_CHUNK_SIZE ? size - i : FIRMWARE_CRC_CHUNK_SIZE;
+		_flash.readBytes(i + FIRMWARE_START_OFFSET, buffer, length);
+		for (uint16_t j = 0; j < length; ++j) {
+			crc = firmwareCrc(crc, buffer[j]);
 		}
 	}
 	OTA_DEBUG(PSTR("OTA:CRC:B=%04X,C=%04X,F=%04X\n"), _nodeFirmwareConfig.blocks,crc,
@@ -39,11 +39,18 @@
 * | | OTA  | FWP	| UPDATE									| FW update initiated
 * |!| OTA  | FWP	| FLASH INIT FAIL							| Failed to initialise flash
 * | | OTA  | FWP	| UPDATE SKIPPED							| FW update skipped, no newer version available
+* |!| OTA  | FWP	| SIZE B=%04X								| FW update skipped, (B) blocks exceed FIRMWARE_MAX_SIZE
+* | | OTA  | FWP	| TRANSFER F=%02X,B=%04X					| FW is transferred compressed, as patch or by multicast (F) in (B) blocks
+* | | OTA  | FWP	| ROUND END,M=%04X							| Multicast round ended, blocks missing (M)
 * | | OTA  | FWP	| RECV B=%04X								| Received FW block (B)
+* | | OTA  | FWP	| SKIP B=%04X								| Skipped FW block (B), duplicate or outside the transfer window
 * | | OTA  | FWP	| FW END									| FW received, proceed to CRC verification
 * | | OTA  | FWP	| CRC OK									| FW CRC verification OK
+* |!| OTA  | FWP	| DECOMPRESS FAIL							| Compressed FW is corrupt
+* |!| OTA  | FWP	| PATCH FAIL								| FW patch is corrupt or does not match the running FW
 * |!| OTA  | FWP	| CRC FAIL									| FW CRC verification failed
 * | | OTA  | FRQ	| FW REQ,T=%04X,V=%04X,B=%04X				| Request FW update, FW type (T), version (V), block (B)
+* | | OTA  | FRQ	| FW NACK,M=%04X,R=%d						| Multicast blocks missing (M), reported in ranges (R)
 * |!| OTA  | FRQ	| FW UPD FAIL								| FW update failed
 * | | OTA  | CRC	| B=%04X,C=%04X,F=%04X						| FW CRC verification. FW blocks (B), calculated CRC (C), FW CRC (F)
 *
@@ -56,12 +63,46 @@
 #define MyOTAFirmwareUpdate_h
 
 #include "MySensorsCore.h"
+#include "MyTransport.h"
 
 #define FIRMWARE_BLOCK_SIZE		(16u)				//!< Size of each firmware block
 #define FIRMWARE_MAX_REQUESTS	(5u)				//!< Number of times a firmware block should be requested before giving up
 #define MY_OTA_RETRY			(5u)				//!< Number of times to request a fw block before giving up
 #define MY_OTA_RETRY_DELAY		(500u)				//!< Number of milliseconds before re-requesting a FW block
 #define FIRMWARE_START_OFFSET	(10u)				//!< Start offset for firmware in flash (DualOptiboot wants to keeps a signature first)
+#define FIRMWARE_CRC_CHUNK_SIZE	(64u)				//!< Bytes read from flash per transaction when verifying the firmware
+#define FIRMWARE_SECTOR_SIZE	(4096ul)			//!< Size of the flash sectors erased before use
+#define FIRMWARE_ERASE_SECTORS	(64u)				//!< Sectors erased in the background, covering the image, transfer and bitmap areas
+#if defined(FLASHEND) && (FLASHEND < 0xFFF0ul)
+#define FIRMWARE_MAX_SIZE		((uint32_t)FLASHEND + 1u)	//!< Largest firmware image, the program memory of the target
+#else
+#define FIRMWARE_MAX_SIZE		(0xFFF0ul)			//!< Largest firmware image, the DualOptiboot header holds a 16-bit size
+#endif
+#define FIRMWARE_SECTOR_ALIGN(address)	(((address) + FIRMWARE_SECTOR_SIZE - 1u) / FIRMWARE_SECTOR_SIZE * FIRMWARE_SECTOR_SIZE)	//!< Start of the first flash sector at or after address
+#define FIRMWARE_TRANSFER_OFFSET	FIRMWARE_SECTOR_ALIGN(FIRMWARE_START_OFFSET + FIRMWARE_MAX_SIZE)	//!< Flash offset a compressed firmware or patch is received to before it is decoded, after the largest image
+#define FIRMWARE_FLAG_COMPRESSED	(0x01u)			//!< Transfer flag, firmware is sent compressed
+#define FIRMWARE_FLAG_DELTA		(0x02u)				//!< Transfer flag, firmware is sent as patch against the running firmware
+#define FIRMWARE_FLAG_MULTICAST	(0x04u)				//!< Transfer flag, firmware blocks are broadcast to all nodes updating the same firmware
+#define FIRMWARE_MULTICAST_BITMAP_OFFSET	FIRMWARE_SECTOR_ALIGN(FIRMWARE_TRANSFER_OFFSET + FIRMWARE_MAX_SIZE)	//!< Flash offset of the bitmap of blocks still missing in a multicast transfer, after the transfer area
+#define FIRMWARE_MULTICAST_ROUND_END	(0xFFFFu)		//!< Block index of the broadcast ending a multicast round
+#define FIRMWARE_NACK_RANGES	(4u)				//!< Max. number of ranges of missing blocks per NACK
+#define FIRMWARE_DELTA_MIN_COPY	(4u)				//!< Shortest copy of a firmware patch
+#define FIRMWARE_DELTA_MAX_COPY	(FIRMWARE_DELTA_MIN_COPY + 127u)	//!< Longest copy of a firmware patch
+#define FIRMWARE_LZ_MIN_MATCH	(3u)				//!< Shortest back-reference of the compressed firmware format
+#define FIRMWARE_LZ_MAX_MATCH	(FIRMWARE_LZ_MIN_MATCH + 15u)	//!< Longest back-reference of the compressed firmware format
+#define FIRMWARE_LZ_WINDOW		(4096u)				//!< Largest back-reference distance of the compressed firmware format
+
+#if (MY_OTA_WINDOW_SIZE < 1) || (MY_OTA_WINDOW_SIZE > 32)
+#error MY_OTA_WINDOW_SIZE must be between 1 and 32
+#endif
+
+#if defined(MY_OTA_COMPRESSION) || defined(MY_OTA_DELTA) || defined(MY_OTA_MULTICAST)
+#define MY_OTA_TRANSFER_ENCODING	//!< Firmware may be sent compressed, as patch or by multicast
+#endif
+
+#if defined(MY_OTA_DELTA) && !defined(ARDUINO_ARCH_AVR)
+#error MY_OTA_DELTA reads the running firmware from program memory, this is only supported on AVR
+#endif
 
 #define MY_OTA_BOOTLOADER_MAJOR_VERSION (3u)		//!< Bootloader version major
 #define MY_OTA_BOOTLOADER_MINOR_VERSION (0u)		//!< Bootloader version minor
@@ -112,6 +153,82 @@ typedef struct {
 	uint8_t data[FIRMWARE_BLOCK_SIZE];			//!< Block data
 } __attribute__((packed)) replyFirmwareBlock_t;
 
+/**
+* @brief FW block broadcast structure of a multicast transfer
+*
+* Nodes of one type may update with different encodings at the same time, the flags tell the sessions apart.
+*/
+typedef struct {
+	uint16_t type;								//!< Type of config
+	uint16_t version;							//!< Version of config
+	uint16_t block;								//!< Block index, FIRMWARE_MULTICAST_ROUND_END for the round end marker
+	uint8_t flags;								//!< Transfer flags of the session, including FIRMWARE_FLAG_MULTICAST
+	uint8_t data[FIRMWARE_BLOCK_SIZE];			//!< Block data
+} __attribute__((packed)) replyFirmwareBlockMulticast_t;
+
+/**
+* @brief FW config request structure of nodes supporting compressed or patched firmware
+*/
+typedef struct {
+	requestFirmwareConfig_t request;			//!< Regular config request
+	uint8_t flags;								//!< Supported encodings, FIRMWARE_FLAG_COMPRESSED and FIRMWARE_FLAG_DELTA
+} __attribute__((packed)) requestFirmwareConfigTransfer_t;
+
+/**
+* @brief FW config reply structure for compressed or patched firmware
+*
+* Sent instead of @ref nodeFirmwareConfig_t to nodes announcing support. The blocks requested and sent
+* are then those of the compressed firmware or patch, decoded by the node once all have been received.
+*
+* A compressed firmware (FIRMWARE_FLAG_COMPRESSED) is an LZSS stream: a flag byte announces the next
+* 8 items, LSB first. A cleared bit is a literal byte, a set bit a back-reference of two bytes, distance-1
+* in the upper 12 bits and length-FIRMWARE_LZ_MIN_MATCH in the lower 4 bits.
+*
+* A patch (FIRMWARE_FLAG_DELTA) is a sequence of commands. A command byte below 0x80 is followed by
+* command+1 literal bytes. A command byte from 0x80 copies (command & 0x7F)+FIRMWARE_DELTA_MIN_COPY bytes
+* from the running firmware, at the output position plus the signed 16 bit little endian offset following
+* the command byte.
+*
+* Both are padded with 0xFF to full blocks.
+*/
+typedef struct {
+	nodeFirmwareConfig_t config;				//!< Config of the new firmware
+	uint16_t transferBlocks;					//!< Number of blocks of the compressed firmware or patch
+	uint8_t flags;								//!< Encoding, FIRMWARE_FLAG_COMPRESSED or FIRMWARE_FLAG_DELTA
+} __attribute__((packed)) replyFirmwareConfigTransfer_t;
+
+/**
+* @brief FW block request structure for compressed or patched firmware
+*/
+typedef struct {
+	uint16_t type;								//!< Type of config
+	uint16_t version;							//!< Version of config
+	uint16_t block;								//!< Block index of the compressed firmware or patch
+	uint8_t flags;								//!< Encoding, FIRMWARE_FLAG_COMPRESSED or FIRMWARE_FLAG_DELTA
+	uint16_t baseVersion;						//!< Version of the running firmware a patch applies to
+} __attribute__((packed)) requestFirmwareBlockTransfer_t;
+
+/**
+* @brief Range of missing blocks
+*/
+typedef struct {
+	uint16_t first;								//!< First missing block
+	uint16_t count;								//!< Number of missing blocks
+} __attribute__((packed)) firmwareRange_t;
+
+/**
+* @brief NACK of a multicast transfer, sent as ST_FIRMWARE_REQUEST with FIRMWARE_FLAG_MULTICAST set
+*
+* The gateway broadcasts the blocks of the ranges again. Only the ranges in use are sent.
+*/
+typedef struct {
+	uint16_t type;								//!< Type of config
+	uint16_t version;							//!< Version of config
+	uint16_t missing;							//!< Total number of blocks still missing
+	uint8_t flags;								//!< Transfer flags of the session, including FIRMWARE_FLAG_MULTICAST
+	firmwareRange_t ranges[FIRMWARE_NACK_RANGES];	//!< Missing blocks, lowest first
+} __attribute__((packed)) requestFirmwareNack_t;
+
 
 /**
  * @brief Read firmware settings from EEPROM
@@ -127,8 +244,9 @@ void firmwareOTAUpdateRequest(void);
  * @brief Handle OTA FW update responses
  *
  * This function handles incoming OTA FW packets and stores them to external flash (Sensebender)
+ * @param message Received C_STREAM message
  */
-bool firmwareOTAUpdateProcess(void);
+bool firmwareOTAUpdateProcess(MyMessage &message);
 /**
  * @brief Validate uploaded FW CRC
  *
@@ -63,6 +63,10 @@ void _process(void)
 	transportProcess();
 #endif
 
+#if defined(MY_OTA_FIRMWARE_SERVER)
+	firmwareServerMulticast();
+#endif
+
 #if defined(__linux__)
 	// To avoid high cpu usage
 	usleep(10000); // 10ms
@@ -354,12 +358,11 @@ bool requestTime(const bool ack)
 	return _sendRoute(build(_msgTmp, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_TIME, ack).set(""));
 }
 
-// Message delivered through _msg
-bool _processInternalMessages(void)
+bool _processInternalMessages(MyMessage &message)
 {
-	const uint8_t type = _msg.type;
+	const uint8_t type = message.type;
 
-	if (_msg.sender == GATEWAY_ADDRESS) {
+	if (message.sender == GATEWAY_ADDRESS) {
 		if (type == I_REBOOT) {
 #if !defined(MY_DISABLE_REMOTE_RESET)
 			// Requires MySensors or other bootloader with watchdogs enabled
@@ -368,14 +371,14 @@ bool _processInternalMessages(void)
 #endif
 		} else if (type == I_REGISTRATION_RESPONSE) {
 #if defined (MY_REGISTRATION_FEATURE) && !defined(MY_GATEWAY_FEATURE)
-			_coreConfig.nodeRegistered = _msg.getBool();
+			_coreConfig.nodeRegistered = message.getBool();
 			setIndication(INDICATION_GOT_REGISTRATION);
 			CORE_DEBUG(PSTR("MCO:PIM:NODE REG=%d\n"), _coreConfig.nodeRegistered);	// node registration
 #endif
 		} else if (type == I_CONFIG) {
 			// Pick up configuration from controller (currently only metric/imperial) and store it in eeprom if changed
-			_coreConfig.controllerConfig.isMetric = _msg.data[0] == 0x00 ||
-			                                        _msg.data[0] == 'M'; // metric if null terminated or M
+			_coreConfig.controllerConfig.isMetric = message.data[0] == 0x00 ||
+			                                        message.data[0] == 'M'; // metric if null terminated or M
 			hwWriteConfigBlock((void*)&_coreConfig.controllerConfig, (void*)EEPROM_CONTROLLER_CONFIG_ADDRESS,
 			                   sizeof(controllerConfig_t));
 		} else if (type == I_PRESENTATION) {
@@ -386,11 +389,11 @@ bool _processInternalMessages(void)
 		} else if (type == I_TIME) {
 			// Deliver time to callback
 			if (receiveTime) {
-				receiveTime(_msg.getULong());
+				receiveTime(message.getULong());
 			}
 		} else if (type == I_CHILDREN) {
 #if defined(MY_REPEATER_FEATURE)
-			if (_msg.data[0] == 'C') {
+			if (message.data[0] == 'C') {
 				// Clears child relay data for this node
 				setIndication(INDICATION_CLEAR_ROUTING);
 				transportClearRoutingTable();
@@ -399,7 +402,7 @@ bool _processInternalMessages(void)
 #endif
 		} else if (type == I_DEBUG) {
 #if defined(MY_DEBUG) || defined(MY_SPECIAL_DEBUG)
-			const char debug_msg = _msg.data[0];
+			const char debug_msg = message.data[0];
 			if (debug_msg == 'R') {		// routing table
 #if defined(MY_REPEATER_FEATURE)
 				for (uint16_t cnt = 0; cnt < SIZE_ROUTES; cnt++) {
@@ -443,7 +446,7 @@ bool _processInternalMessages(void)
 			bool approveRegistration;
 
 #if defined(MY_CORE_COMPATIBILITY_CHECK)
-			approveRegistration = (_msg.getByte() >= MY_CORE_MIN_VERSION);
+			approveRegistration = (message.getByte() >= MY_CORE_MIN_VERSION);
 #else
 			// auto registration if version compatible
 			approveRegistration = true;
@@ -453,7 +456,7 @@ bool _processInternalMessages(void)
 			// delay for fast GW and slow nodes
 			delay(5);
 #endif
-			(void)_sendRoute(build(_msgTmp, _msg.sender, NODE_SENSOR_ID, C_INTERNAL,
+			(void)_sendRoute(build(_msgTmp, message.sender, NODE_SENSOR_ID, C_INTERNAL,
 			                       I_REGISTRATION_RESPONSE).set(approveRegistration));
 #else
 			return false;	// processing of this request via controller
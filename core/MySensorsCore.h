@@ -370,9 +370,10 @@ void _begin(void);
 void _process(void);
 /**
 * @brief Processes internal messages
+* @param message Received message
 * @return True if received message requires further processing
 */
-bool _processInternalMessages(void);
+bool _processInternalMessages(MyMessage &message);
 /**
 * @brief Puts node to a infinite loop if unrecoverable situation detected
 */
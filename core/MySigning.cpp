@@ -51,7 +51,21 @@ static uint8_t nof_failed_verifications = 0;
 #endif
 
 // Status when waiting for signing nonce in signerSignMsg
-enum { SIGN_WAITING_FOR_NONCE = 0, SIGN_OK = 1 };
+enum { SIGN_WAITING_FOR_NONCE = 0, SIGN_OK = 1, SIGN_IDLE = 2 };
+
+#if defined(MY_SIGNING_NONCE_PREFETCH)
+// Status of a prefetched nonce
+enum { SIGN_NONCE_FREE = 0, SIGN_NONCE_REQUEST_PENDING = 1, SIGN_NONCE_REQUESTED = 2, SIGN_NONCE_CACHED = 3 };
+
+// Nonce requested in advance for the next signed message to a node
+typedef struct {
+	uint8_t nodeId;             // Node the nonce is requested from
+	uint8_t status;             // See SIGN_NONCE_* above
+	unsigned long timestamp;    // hwMillis() when the nonce was requested or received
+	uint8_t nonce[MAX_PAYLOAD];
+} signingNonceCache_t;
+static signingNonceCache_t _signingNonceCache[MY_SIGNING_NONCE_CACHE_SIZE];
+#endif
 
 // Macros for manipulating signing requirement tables
 #define DO_SIGN(node) (~_doSign[node>>3]&(1<<node%8))
@@ -89,6 +103,14 @@ extern bool signerAtsha204SignMsg(MyMessage &msg);
 #define signerBackendSignMsg    signerAtsha204SignMsg
 #endif
 static bool skipSign(MyMessage &msg);
+#if defined(MY_SIGNING_NONCE_PREFETCH)
+static signingNonceCache_t* signerNonceCacheGet(uint8_t nodeId, bool allocate);
+static void signerNonceCacheProcess(void);
+static bool signerNonceCacheSign(MyMessage &msg);
+static bool signerNonceCacheRequested(uint8_t nodeId);
+static bool signerNonceCacheStore(MyMessage &msg);
+static void signerNonceCachePrefetch(uint8_t nodeId);
+#endif
 #else // not MY_SIGNING_FEATURE
 #define signerBackendCheckTimer() true
 #endif // MY_SIGNING_FEATURE
@@ -108,6 +130,7 @@ void signerInit(void)
 	hwReadConfigBlock((void*)_doWhitelist, (void*)EEPROM_WHITELIST_REQUIREMENT_TABLE_ADDRESS,
 	                  sizeof(_doWhitelist));
 
+	_signingNonceStatus = SIGN_IDLE;
 	signerBackendInit();
 #endif
 }
@@ -157,6 +180,9 @@ bool signerProcessInternal(MyMessage &msg)
 
 bool signerCheckTimer(void)
 {
+#if defined(MY_SIGNING_FEATURE) && defined(MY_SIGNING_NONCE_PREFETCH)
+	signerNonceCacheProcess();
+#endif
 	return signerBackendCheckTimer();
 }
 
@@ -169,11 +195,23 @@ bool signerSignMsg(MyMessage &msg)
 	if (DO_SIGN(msg.destination) && msg.sender == getNodeId()) {
 		if (skipSign(msg)) {
 			ret = true;
+#if defined(MY_SIGNING_NONCE_PREFETCH)
+		} else if (signerNonceCacheSign(msg)) {
+			SIGN_DEBUG(PSTR("Message to send has been signed with prefetched nonce\n"));
+			ret = true;
+#endif
 		} else {
 			// Send nonce-request
 			_signingNonceStatus=SIGN_WAITING_FOR_NONCE;
+#if defined(MY_SIGNING_NONCE_PREFETCH)
+			// If a nonce has already been requested in advance, wait for that one instead
+			if (!signerNonceCacheRequested(msg.destination) &&
+			        !_sendRoute(build(_msgSign, msg.destination, msg.sensor, C_INTERNAL,
+			                          I_NONCE_REQUEST).set(""))) {
+#else
 			if (!_sendRoute(build(_msgSign, msg.destination, msg.sensor, C_INTERNAL,
 			                      I_NONCE_REQUEST).set(""))) {
+#endif
 				SIGN_DEBUG(PSTR("Failed to transmit nonce request!\n"));
 				ret = false;
 			} else {
@@ -197,12 +235,16 @@ bool signerSignMsg(MyMessage &msg)
 						ret = true;
 						// After this point, only the 'last' member of the message structure is allowed to be altered if the
 						// message has been signed, or signature will become invalid and the message rejected by the receiver
+#if defined(MY_SIGNING_NONCE_PREFETCH)
+						signerNonceCachePrefetch(msg.destination);
+#endif
 					} else {
 						SIGN_DEBUG(PSTR("Message to send could not be signed!\n"));
 						ret = false;
 					}
 				}
 			}
+			_signingNonceStatus = SIGN_IDLE;
 		}
 	} else if (getNodeId() == msg.sender) {
 		mSetSigned(msg, 0); // Message is not supposed to be signed, make sure it is marked unsigned
@@ -281,9 +323,7 @@ void signerSha256Init(void)
 
 void signerSha256Update(const uint8_t* data, size_t sz)
 {
-	for (size_t i = 0; i < sz; i++) {
-		_soft_sha256.write(data[i]);
-	}
+	_soft_sha256.write(data, sz);
 }
 
 uint8_t* signerSha256Final(void)
@@ -488,6 +528,13 @@ static bool signerInternalProcessNonceResponse(MyMessage &msg)
 #if defined(MY_SIGNING_FEATURE)
 	// Proceed with signing if nonce has been received
 	SIGN_DEBUG(PSTR("Nonce received from %d.\n"), msg.sender);
+#if defined(MY_SIGNING_NONCE_PREFETCH)
+	if ((_signingNonceStatus != SIGN_WAITING_FOR_NONCE || msg.sender != _msgSign.destination) &&
+	        signerNonceCacheStore(msg)) {
+		SIGN_DEBUG(PSTR("Prefetched nonce stored\n"));
+		return true;
+	}
+#endif
 	if (msg.sender != _msgSign.destination) {
 		SIGN_DEBUG(PSTR("Nonce did not come from the destination (%d) of the message to be signed! "
 		                "It came from %d.\n"), _msgSign.destination, msg.sender);
@@ -508,3 +555,119 @@ static bool signerInternalProcessNonceResponse(MyMessage &msg)
 #endif
 	return true; // No need to further process I_NONCE_RESPONSE
 }
+
+#if defined(MY_SIGNING_FEATURE) && defined(MY_SIGNING_NONCE_PREFETCH)
+// Helper to find the prefetch entry of a node, optionally allocating one (the oldest entry is reused if needed)
+static signingNonceCache_t* signerNonceCacheGet(uint8_t nodeId, bool allocate)
+{
+	signingNonceCache_t* entry = NULL;
+	for (uint16_t i = 0; i < MY_SIGNING_NONCE_CACHE_SIZE; i++) {
+		if (_signingNonceCache[i].status != SIGN_NONCE_FREE && _signingNonceCache[i].nodeId == nodeId) {
+			return &_signingNonceCache[i];
+		}
+	}
+	if (!allocate) {
+		return NULL;
+	}
+	const unsigned long now = hwMillis();
+	for (uint16_t i = 0; i < MY_SIGNING_NONCE_CACHE_SIZE; i++) {
+		if (_signingNonceCache[i].status == SIGN_NONCE_FREE) {
+			entry = &_signingNonceCache[i];
+			break;
+		}
+		if (entry == NULL || now - _signingNonceCache[i].timestamp > now - entry->timestamp) {
+			entry = &_signingNonceCache[i];
+		}
+	}
+	entry->nodeId = nodeId;
+	return entry;
+}
+
+// Helper to transmit pending nonce requests and purge expired nonces
+static void signerNonceCacheProcess(void)
+{
+	const unsigned long now = hwMillis();
+	for (uint16_t i = 0; i < MY_SIGNING_NONCE_CACHE_SIZE; i++) {
+		signingNonceCache_t* entry = &_signingNonceCache[i];
+		if (entry->status == SIGN_NONCE_REQUEST_PENDING) {
+			// Separate buffer, this may run while _msgSign holds a message waiting for its nonce
+			MyMessage request;
+			if (_sendRoute(build(request, entry->nodeId, NODE_SENSOR_ID, C_INTERNAL,
+			                     I_NONCE_REQUEST).set(""))) {
+				SIGN_DEBUG(PSTR("Nonce prefetch requested from %d\n"), entry->nodeId);
+				entry->status = SIGN_NONCE_REQUESTED;
+				entry->timestamp = now;
+			} else {
+				SIGN_DEBUG(PSTR("Failed to transmit nonce prefetch request!\n"));
+				entry->status = SIGN_NONCE_FREE;
+			}
+		} else if ((entry->status == SIGN_NONCE_REQUESTED &&
+		            now - entry->timestamp > MY_VERIFICATION_TIMEOUT_MS) ||
+		           (entry->status == SIGN_NONCE_CACHED &&
+		            now - entry->timestamp > MY_VERIFICATION_TIMEOUT_MS / 2)) {
+			memset(entry->nonce, 0xAA, MAX_PAYLOAD);
+			entry->status = SIGN_NONCE_FREE;
+		}
+	}
+}
+
+// Helper to sign a message with a prefetched nonce, returns false if there is no usable nonce
+static bool signerNonceCacheSign(MyMessage &msg)
+{
+	signingNonceCache_t* entry = signerNonceCacheGet(msg.destination, false);
+	if (entry == NULL || entry->status != SIGN_NONCE_CACHED) {
+		return false;
+	}
+	// The verifier issued the nonce before we got it, so only half the verification timeout is
+	// used to leave room for the signed message to get there
+	const bool valid = hwMillis() - entry->timestamp < MY_VERIFICATION_TIMEOUT_MS / 2;
+	if (valid) {
+		(void)_msgSign.set(entry->nonce, MAX_PAYLOAD);
+		signerBackendPutNonce(_msgSign);
+	}
+	// A nonce is only used once
+	memset(entry->nonce, 0xAA, MAX_PAYLOAD);
+	entry->status = SIGN_NONCE_FREE;
+	if (!valid || !signerBackendSignMsg(msg)) {
+		return false;
+	}
+	signerNonceCachePrefetch(msg.destination);
+	return true;
+}
+
+// Helper to check if a nonce has already been requested from a node. Any prefetch state for the node
+// is dropped as the nonce will be waited for by signerSignMsg.
+static bool signerNonceCacheRequested(uint8_t nodeId)
+{
+	signingNonceCache_t* entry = signerNonceCacheGet(nodeId, false);
+	if (entry == NULL) {
+		return false;
+	}
+	const bool requested = entry->status == SIGN_NONCE_REQUESTED;
+	memset(entry->nonce, 0xAA, MAX_PAYLOAD);
+	entry->status = SIGN_NONCE_FREE;
+	return requested;
+}
+
+// Helper to store a nonce we have requested in advance, returns false if it was not asked for
+static bool signerNonceCacheStore(MyMessage &msg)
+{
+	signingNonceCache_t* entry = signerNonceCacheGet(msg.sender, false);
+	if (entry == NULL || entry->status != SIGN_NONCE_REQUESTED) {
+		return false;
+	}
+	memcpy(entry->nonce, (uint8_t*)msg.getCustom(), MAX_PAYLOAD);
+	entry->status = SIGN_NONCE_CACHED;
+	entry->timestamp = hwMillis();
+	return true;
+}
+
+// Helper to schedule a nonce request for the next signed message to a node. The request is
+// transmitted by signerCheckTimer(), after the message that was just signed has been sent.
+static void signerNonceCachePrefetch(uint8_t nodeId)
+{
+	signingNonceCache_t* entry = signerNonceCacheGet(nodeId, true);
+	entry->status = SIGN_NONCE_REQUEST_PENDING;
+	entry->timestamp = hwMillis();
+}
+#endif
@@ -180,6 +180,7 @@
  * It is important that the pin is floating, or the output of the pseudo-random generator will be predictable, and thus compromise the
  * signatures. The setting is defined using @ref MY_SIGNING_SOFT_RANDOMSEED_PIN and the default is to use pin A7. The same configuration
  * possibilities exist as with the other configuration options.
+ * On Linux the software backend takes its nonces from the kernel (getrandom() or /dev/urandom) instead, and no seed pin is used.
  *
  * <b>Thirdly</b>, if you use the software backend, you need to personalize the node (see @ref personalization).
  * @code{.cpp}
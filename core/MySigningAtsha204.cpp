@@ -199,7 +199,7 @@ bool signerAtsha204VerifyMsg(MyMessage &msg)
 		return false;
 	} else {
 		// Make sure we have not expired
-		if (!signerCheckTimer()) {
+		if (!signerAtsha204CheckTimer()) {
 			return false;
 		}
 
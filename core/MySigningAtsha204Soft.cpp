@@ -32,16 +32,27 @@
 #include "drivers/ATSHA204/sha256.h"
 
 #define SIGNING_IDENTIFIER (1)
+#define SIGNING_SESSION_FREE (0xFFu) // Broadcast address, never requests a nonce
 
 // Define MY_DEBUG_VERBOSE_SIGNING in your sketch to enable signing backend debugprints
 
 Sha256Class _signing_sha256;
-unsigned long _signing_timestamp;
-bool _signing_verification_ongoing = false;
+/**
+ * @brief Verification session, one nonce handed out to a specific sender.
+ *
+ * Only the part of the nonce that was transmitted is kept, the rest is always 0xAA.
+ */
+typedef struct {
+	uint8_t nodeId;             //!< Node the nonce was issued to (@ref SIGNING_SESSION_FREE if unused)
+	unsigned long timestamp;    //!< hwMillis() when the nonce was issued
+	uint8_t nonce[MAX_PAYLOAD]; //!< Transmitted part of the nonce
+} signingSession_t;
+static signingSession_t _signing_sessions[MY_SIGNING_SOFT_MAX_SESSIONS];
 uint8_t _signing_verifying_nonce[32];
 uint8_t _signing_signing_nonce[32];
+static uint8_t _signing_next_nonce[MAX_PAYLOAD]; // Generated ahead of the next nonce request
+static bool _signing_next_nonce_ready = false;
 uint8_t _signing_temp_message[32];
-static uint8_t _signing_hmac_key[32];
 uint8_t _signing_hmac[32];
 extern uint8_t _doWhitelist[32];
 
@@ -51,6 +62,10 @@ const whitelist_entry_t _signing_whitelist[] = MY_SIGNING_NODE_WHITELISTING;
 #endif
 
 static void signerCalculateSignature(MyMessage &msg, bool signing);
+static signingSession_t* signerGetSession(uint8_t nodeId);
+static signingSession_t* signerNewSession(uint8_t nodeId);
+static void signerPurgeSession(signingSession_t* session);
+static void signerGenerateNonce(void);
 
 #ifdef MY_DEBUG_VERBOSE_SIGNING
 static char i2h(uint8_t i)
@@ -105,52 +120,61 @@ void signerAtsha204SoftInit(void)
 	// initialize pseudo-RNG
 	hwRandomNumberInit();
 	// Set secrets
-	hwReadConfigBlock((void*)_signing_hmac_key, (void*)EEPROM_SIGNING_SOFT_HMAC_KEY_ADDRESS, 32);
+	// The HMAC key is only needed to precompute the keyed SHA256 states, it is not kept in RAM
+	hwReadConfigBlock((void*)_signing_hmac, (void*)EEPROM_SIGNING_SOFT_HMAC_KEY_ADDRESS, 32);
+	_signing_sha256.initHmac(_signing_hmac, 32);
+	memset(_signing_hmac, 0, 32);
 	hwReadConfigBlock((void*)_signing_node_serial_info, (void*)EEPROM_SIGNING_SOFT_SERIAL_ADDRESS, 9);
+	// No verification sessions are active
+	for (uint16_t i = 0; i < MY_SIGNING_SOFT_MAX_SESSIONS; i++) {
+		signerPurgeSession(&_signing_sessions[i]);
+	}
+	_signing_next_nonce_ready = false;
 }
 
 bool signerAtsha204SoftCheckTimer(void)
 {
-	if (_signing_verification_ongoing) {
-		if (hwMillis() < _signing_timestamp ||
-		        hwMillis() > _signing_timestamp + MY_VERIFICATION_TIMEOUT_MS) {
+	bool ret = true;
+	const unsigned long now = hwMillis();
+	for (uint16_t i = 0; i < MY_SIGNING_SOFT_MAX_SESSIONS; i++) {
+		signingSession_t* session = &_signing_sessions[i];
+		if (session->nodeId != SIGNING_SESSION_FREE &&
+		        now - session->timestamp > MY_VERIFICATION_TIMEOUT_MS) {
 			DEBUG_SIGNING_PRINTBUF(F("Verification timeout"), NULL, 0);
-			// Purge nonce
-			memset(_signing_signing_nonce, 0xAA, 32);
-			memset(_signing_verifying_nonce, 0xAA, 32);
-			_signing_verification_ongoing = false;
-			return false;
+			signerPurgeSession(session);
+			ret = false;
 		}
 	}
-	return true;
+	// Prepare the next nonce while idle so a nonce request can be answered right away
+	if (!_signing_next_nonce_ready) {
+		signerGenerateNonce();
+	}
+	return ret;
 }
 
 bool signerAtsha204SoftGetNonce(MyMessage &msg)
 {
 	DEBUG_SIGNING_PRINTBUF(F("Signing backend: ATSHA204Soft"), NULL, 0);
 
-	// We used a basic whitening technique that XORs a random byte with the current hwMillis() counter and then the byte is
-	// hashed (SHA256) to produce the resulting nonce
-	_signing_sha256.init();
-	for (int i = 0; i < 32; i++) {
-		_signing_sha256.write(random(256) ^ (hwMillis()&0xFF));
+	if (!_signing_next_nonce_ready) {
+		signerGenerateNonce();
 	}
-	memcpy(_signing_verifying_nonce, _signing_sha256.result(), MAX_PAYLOAD);
+	memcpy(_signing_verifying_nonce, _signing_next_nonce, MAX_PAYLOAD);
+	memset(_signing_next_nonce, 0xAA, MAX_PAYLOAD);
+	_signing_next_nonce_ready = false;
 	DEBUG_SIGNING_PRINTBUF(F("SHA256: "), _signing_verifying_nonce, 32);
 
 	// We set the part of the 32-byte nonce that does not fit into a message to 0xAA
 	memset(&_signing_verifying_nonce[MAX_PAYLOAD], 0xAA, sizeof(_signing_verifying_nonce)-MAX_PAYLOAD);
 
+	// Store the nonce in the session of the requesting node, any previous nonce issued to it is replaced
+	signingSession_t* session = signerNewSession(msg.sender);
+	memcpy(session->nonce, _signing_verifying_nonce, MAX_PAYLOAD);
+	session->timestamp = hwMillis(); // Set timestamp to determine when to purge nonce
+	memset(_signing_verifying_nonce, 0xAA, sizeof(_signing_verifying_nonce));
+
 	// Transfer the first part of the nonce to the message
-	msg.set(_signing_verifying_nonce, MAX_PAYLOAD);
-	_signing_verification_ongoing = true;
-	_signing_timestamp = hwMillis(); // Set timestamp to determine when to purge nonce
-	// Be a little fancy to handle turnover (prolong the time allowed to timeout after turnover)
-	// Note that if message is "too" quick, and arrives before turnover, it will be rejected
-	// but this is consider such a rare case that it is accepted and rejects are 'safe'
-	if (_signing_timestamp + MY_VERIFICATION_TIMEOUT_MS < hwMillis()) {
-		_signing_timestamp = 0;
-	}
+	msg.set(session->nonce, MAX_PAYLOAD);
 	return true;
 }
 
@@ -178,13 +202,9 @@ bool signerAtsha204SoftSignMsg(MyMessage &msg)
 	if (DO_WHITELIST(msg.destination)) {
 		// Salt the signature with the senders nodeId and the (hopefully) unique serial The Creator has provided
 		_signing_sha256.init();
-		for (int i=0; i<32; i++) {
-			_signing_sha256.write(_signing_hmac[i]);
-		}
+		_signing_sha256.write(_signing_hmac, 32);
 		_signing_sha256.write(msg.sender);
-		for (int i=0; i<SHA204_SERIAL_SZ; i++) {
-			_signing_sha256.write(_signing_node_serial_info[i]);
-		}
+		_signing_sha256.write(_signing_node_serial_info, SHA204_SERIAL_SZ);
 		memcpy(_signing_hmac, _signing_sha256.result(), 32);
 		DEBUG_SIGNING_PRINTBUF(F("SHA256: "), _signing_hmac, 32);
 		DEBUG_SIGNING_PRINTBUF(F("Signature salted with serial"), NULL, 0);
@@ -203,16 +223,22 @@ bool signerAtsha204SoftSignMsg(MyMessage &msg)
 
 bool signerAtsha204SoftVerifyMsg(MyMessage &msg)
 {
-	if (!_signing_verification_ongoing) {
+	signingSession_t* session = signerGetSession(msg.sender);
+	if (session == NULL) {
 		DEBUG_SIGNING_PRINTBUF(F("No active verification session"), NULL, 0);
 		return false;
 	} else {
 		// Make sure we have not expired
-		if (!signerCheckTimer()) {
+		if (hwMillis() - session->timestamp > MY_VERIFICATION_TIMEOUT_MS) {
+			DEBUG_SIGNING_PRINTBUF(F("Verification timeout"), NULL, 0);
+			signerPurgeSession(session);
 			return false;
 		}
 
-		_signing_verification_ongoing = false;
+		// Session is consumed by this verification attempt
+		memcpy(_signing_verifying_nonce, session->nonce, MAX_PAYLOAD);
+		memset(&_signing_verifying_nonce[MAX_PAYLOAD], 0xAA, sizeof(_signing_verifying_nonce)-MAX_PAYLOAD);
+		signerPurgeSession(session);
 
 		if (msg.data[mGetLength(msg)] != SIGNING_IDENTIFIER) {
 			DEBUG_SIGNING_PRINTBUF(F("Incorrect signing identifier"), NULL, 0);
@@ -231,13 +257,9 @@ bool signerAtsha204SoftVerifyMsg(MyMessage &msg)
 			if (_signing_whitelist[j].nodeId == msg.sender) {
 				DEBUG_SIGNING_PRINTBUF(F("Sender found in whitelist"), NULL, 0);
 				_signing_sha256.init();
-				for (int i=0; i<32; i++) {
-					_signing_sha256.write(_signing_hmac[i]);
-				}
+				_signing_sha256.write(_signing_hmac, 32);
 				_signing_sha256.write(msg.sender);
-				for (int i=0; i<SHA204_SERIAL_SZ; i++) {
-					_signing_sha256.write(_signing_whitelist[j].serial[i]);
-				}
+				_signing_sha256.write(_signing_whitelist[j].serial, SHA204_SERIAL_SZ);
 				memcpy(_signing_hmac, _signing_sha256.result(), 32);
 				DEBUG_SIGNING_PRINTBUF(F("SHA256: "), _signing_hmac, 32);
 				break;
@@ -266,13 +288,73 @@ bool signerAtsha204SoftVerifyMsg(MyMessage &msg)
 	}
 }
 
+// Helper to find the verification session of a node (NULL if there is none)
+static signingSession_t* signerGetSession(uint8_t nodeId)
+{
+	for (uint16_t i = 0; i < MY_SIGNING_SOFT_MAX_SESSIONS; i++) {
+		if (_signing_sessions[i].nodeId == nodeId) {
+			return &_signing_sessions[i];
+		}
+	}
+	return NULL;
+}
+
+// Helper to allocate a verification session for a node, reusing its current session if there is one.
+// If all sessions are in use, the oldest one is evicted.
+static signingSession_t* signerNewSession(uint8_t nodeId)
+{
+	signingSession_t* session = signerGetSession(nodeId);
+	if (session == NULL) {
+		session = signerGetSession(SIGNING_SESSION_FREE);
+	}
+	if (session == NULL) {
+		const unsigned long now = hwMillis();
+		session = &_signing_sessions[0];
+		for (uint16_t i = 1; i < MY_SIGNING_SOFT_MAX_SESSIONS; i++) {
+			if (now - _signing_sessions[i].timestamp > now - session->timestamp) {
+				session = &_signing_sessions[i];
+			}
+		}
+		DEBUG_SIGNING_PRINTBUF(F("Verification session evicted"), NULL, 0);
+	}
+	session->nodeId = nodeId;
+	return session;
+}
+
+// Helper to purge the nonce of a verification session and mark it free
+static void signerPurgeSession(signingSession_t* session)
+{
+	session->nodeId = SIGNING_SESSION_FREE;
+	memset(session->nonce, 0xAA, MAX_PAYLOAD);
+}
+
+// Helper to generate the nonce handed out on the next nonce request
+static void signerGenerateNonce(void)
+{
+#if defined(__linux__)
+	// Take the nonce straight from the kernel entropy pool
+	if (hwGetentropy(_signing_next_nonce, MAX_PAYLOAD) == MAX_PAYLOAD) {
+		_signing_next_nonce_ready = true;
+		return;
+	}
+#endif
+	// We used a basic whitening technique that XORs a random byte with the current hwMillis() counter and then the byte is
+	// hashed (SHA256) to produce the resulting nonce
+	_signing_sha256.init();
+	for (int i = 0; i < 32; i++) {
+		_signing_sha256.write(random(256) ^ (hwMillis()&0xFF));
+	}
+	memcpy(_signing_next_nonce, _signing_sha256.result(), MAX_PAYLOAD);
+	_signing_next_nonce_ready = true;
+}
+
 // Helper to calculate signature of msg (returned in hmac)
 static void signerCalculateSignature(MyMessage &msg, bool signing)
 {
 	memset(_signing_temp_message, 0, 32);
-	memcpy(_signing_temp_message, (uint8_t*)&msg.data[1-HEADER_SIZE],
+	memcpy(_signing_temp_message, (uint8_t*)&msg.sender,
 	       MAX_MESSAGE_LENGTH-1-(MAX_PAYLOAD-mGetLength(msg)));
-	DEBUG_SIGNING_PRINTBUF(F("Message to process: "), (uint8_t*)&msg.data[1-HEADER_SIZE],
+	DEBUG_SIGNING_PRINTBUF(F("Message to process: "), (uint8_t*)&msg.sender,
 	                       MAX_MESSAGE_LENGTH-1-(MAX_PAYLOAD-mGetLength(msg)));
 	DEBUG_SIGNING_PRINTBUF(F("Current nonce: "),
 	                       signing ? _signing_signing_nonce : _signing_verifying_nonce, 32);
@@ -300,10 +382,10 @@ static void signerCalculateSignature(MyMessage &msg, bool signing)
 	// 32 bytes nonce
 
 	// Calculate message digest first
+	// (_signing_hmac is used as a source of zeroes, it is overwritten with the result below)
+	memset(_signing_hmac, 0, 32);
 	_signing_sha256.init();
-	for (int i=0; i<32; i++) {
-		_signing_sha256.write(_signing_temp_message[i]);
-	}
+	_signing_sha256.write(_signing_temp_message, 32);
 	_signing_sha256.write(0x15); // OPCODE
 	_signing_sha256.write(0x02); // param1
 	_signing_sha256.write(0x08); // param2(1)
@@ -311,40 +393,26 @@ static void signerCalculateSignature(MyMessage &msg, bool signing)
 	_signing_sha256.write(0xEE); // SN[8]
 	_signing_sha256.write(0x01); // SN[0]
 	_signing_sha256.write(0x23); // SN[1]
-	for (int i=0; i<25; i++) {
-		_signing_sha256.write(0x00);
-	}
-	for (int i=0; i<32; i++) {
-		_signing_sha256.write(signing ? _signing_signing_nonce[i] : _signing_verifying_nonce[i]);
-	}
+	_signing_sha256.write(_signing_hmac, 25); // 25 bytes zeroes
+	_signing_sha256.write(signing ? _signing_signing_nonce : _signing_verifying_nonce, 32);
 	// Purge nonce when used
 	memset(signing ? _signing_signing_nonce : _signing_verifying_nonce, 0xAA, 32);
 	memcpy(_signing_temp_message, _signing_sha256.result(), 32);
 
 	// Feed "message" to HMAC calculator
-	_signing_sha256.initHmac(_signing_hmac_key,32); // Set the key to use
-	for (int i=0; i<32; i++) {
-		_signing_sha256.write(0x00); // 32 bytes zeroes
-	}
-	for (int i=0; i<32; i++) {
-		_signing_sha256.write(_signing_temp_message[i]); // 32 bytes digest
-	}
+	_signing_sha256.resumeHmac(); // Continue from the keyed state prepared by signerAtsha204SoftInit()
+	_signing_sha256.write(_signing_hmac, 32); // 32 bytes zeroes
+	_signing_sha256.write(_signing_temp_message, 32); // 32 bytes digest
 	_signing_sha256.write(0x11); // OPCODE
 	_signing_sha256.write(0x04); // Mode
 	_signing_sha256.write(0x00); // SlotID(1)
 	_signing_sha256.write(0x00); // SlotID(2)
-	for (int i=0; i<11; i++) {
-		_signing_sha256.write(0x00); // 11 bytes zeroes
-	}
+	_signing_sha256.write(_signing_hmac, 11); // 11 bytes zeroes
 	_signing_sha256.write(0xEE); // SN[8]
-	for (int i=0; i<4; i++) {
-		_signing_sha256.write(0x00); // 4 bytes zeroes
-	}
+	_signing_sha256.write(_signing_hmac, 4); // 4 bytes zeroes
 	_signing_sha256.write(0x01); // SN[0]
 	_signing_sha256.write(0x23); // SN[1]
-	for (int i=0; i<2; i++) {
-		_signing_sha256.write(0x00); // 2 bytes zeroes
-	}
+	_signing_sha256.write(_signing_hmac, 2); // 2 bytes zeroes
 
 	memcpy(_signing_hmac, _signing_sha256.resultHmac(), 32);
 
@@ -384,6 +384,9 @@ void transportInitialise(void)
 {
 	_transportSM.failureCounter = 0u;	// reset failure counter
 	transportLoadRoutingTable();		// load routing table to RAM (if feature enabled)
+#if defined(MY_TRANSPORT_ENCRYPTION)
+	transportEncryptionInit();			// load key and frame counter
+#endif
 	// intial state
 	_transportSM.currentState = NULL;
 	transportSwitchSM(stInit);
@@ -575,29 +578,54 @@ uint32_t transportGetHeartbeat(void)
 
 void transportProcessMessage(void)
 {
-	// Manage signing timeout
-	(void)signerCheckTimer();
 	// receive message
 	setIndication(INDICATION_RX);
-	uint8_t payloadLength = transportReceive((uint8_t *)&_msg);
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	// processed in place in the RX queue, relayed from there
+	uint8_t payloadLength;
+	void* message = transportPeek(&payloadLength);
+	if (message) {
+		transportProcessReceived(*(MyMessage *)message, payloadLength);
+		transportRelease(message);
+	}
+#else
+	transportProcessReceived(_msg, transportReceive((uint8_t *)&_msg));
+#endif
+}
+
+void transportProcessReceived(MyMessage &message, uint8_t payloadLength)
+{
+#if defined(MY_TRANSPORT_ENCRYPTION)
+	// authenticate and decrypt, strips frame counter and MAC
+	payloadLength = transportDecryptFrame((uint8_t *)&message, payloadLength);
+	if (!payloadLength) {
+		setIndication(INDICATION_ERR_DECRYPT);
+		TRANSPORT_DEBUG(PSTR("!TSF:MSG:DEC FAIL\n"));	// rejected frame
+		return;
+	}
+#endif
+	if (&message != &_msg) {
+		// wait() and transportWait() match the header of the last message received
+		(void)memcpy((void *)&_msg, (const void *)&message, HEADER_SIZE);
+	}
 	// get message length and limit size
 
-	const uint8_t msgLength = min(mGetLength(_msg), (uint8_t)MAX_PAYLOAD);
+	const uint8_t msgLength = min(mGetLength(message), (uint8_t)MAX_PAYLOAD);
 	// calculate expected length
-	const uint8_t expectedMessageLength = HEADER_SIZE + (mGetSigned(_msg) ? MAX_PAYLOAD : msgLength);
+	const uint8_t expectedMessageLength = HEADER_SIZE + (mGetSigned(message) ? MAX_PAYLOAD : msgLength);
 #if defined(MY_RF24_ENABLE_ENCRYPTION)
 	// payload length = a multiple of blocksize length for decrypted messages, i.e. cannot be used for payload length check
 	payloadLength = expectedMessageLength;
 #endif
-	const uint8_t command = mGetCommand(_msg);
-	const uint8_t type = _msg.type;
-	const uint8_t sender = _msg.sender;
-	const uint8_t last = _msg.last;
-	const uint8_t destination = _msg.destination;
+	const uint8_t command = mGetCommand(message);
+	const uint8_t type = message.type;
+	const uint8_t sender = message.sender;
+	const uint8_t last = message.last;
+	const uint8_t destination = message.destination;
 
 	TRANSPORT_DEBUG(PSTR("TSF:MSG:READ,%d-%d-%d,s=%d,c=%d,t=%d,pt=%d,l=%d,sg=%d:%s\n"),
-	                sender, last, destination, _msg.sensor, command, type, mGetPayloadType(_msg), msgLength,
-	                mGetSigned(_msg), _msg.getString(_convBuf));
+	                sender, last, destination, message.sensor, command, type, mGetPayloadType(message), msgLength,
+	                mGetSigned(message), message.getString(_convBuf));
 
 	// Reject payloads with incorrect length
 	if (payloadLength != expectedMessageLength) {
@@ -608,15 +636,15 @@ void transportProcessMessage(void)
 	}
 
 	// Reject messages with incorrect protocol version
-	if (mGetVersion(_msg) != PROTOCOL_VERSION) {
+	if (mGetVersion(message) != PROTOCOL_VERSION) {
 		setIndication(INDICATION_ERR_VERSION);
-		TRANSPORT_DEBUG(PSTR("!TSF:MSG:PVER,%d=%d\n"), mGetVersion(_msg),
+		TRANSPORT_DEBUG(PSTR("!TSF:MSG:PVER,%d=%d\n"), mGetVersion(message),
 		                PROTOCOL_VERSION);	// protocol version mismatch
 		return;
 	}
 
 	// Reject messages that do not pass verification
-	if (!signerVerifyMsg(_msg)) {
+	if (!signerVerifyMsg(message)) {
 		setIndication(INDICATION_ERR_SIGN);
 		TRANSPORT_DEBUG(PSTR("!TSF:MSG:SIGN VERIFY FAIL\n"));
 		return;
@@ -644,13 +672,13 @@ void transportProcessMessage(void)
 	// Is message addressed to this node?
 	if (destination == _transportConfig.nodeId) {
 		// prevent buffer overflow by limiting max. possible message length (5 bits=31 bytes max) to MAX_PAYLOAD (25 bytes)
-		mSetLength(_msg, min(mGetLength(_msg),(uint8_t)MAX_PAYLOAD));
+		mSetLength(message, min(mGetLength(message),(uint8_t)MAX_PAYLOAD));
 		// null terminate data
-		_msg.data[msgLength] = 0u;
+		message.data[msgLength] = 0u;
 		// Check if sender requests an ack back.
-		if (mGetRequestAck(_msg)) {
+		if (mGetRequestAck(message)) {
 			TRANSPORT_DEBUG(PSTR("TSF:MSG:ACK REQ\n"));	// ACK requested
-			_msgTmp = _msg;	// Copy message
+			_msgTmp = message;	// Copy message
 			mSetRequestAck(_msgTmp,
 			               false); // Reply without ack flag (otherwise we would end up in an eternal loop)
 			mSetAck(_msgTmp, true); // set ACK flag
@@ -659,18 +687,18 @@ void transportProcessMessage(void)
 			// send ACK, use transportSendRoute since ACK reply is not internal, i.e. if !transportOK do not reply
 			(void)transportSendRoute(_msgTmp);
 		}
-		if(!mGetAck(_msg)) {
+		if(!mGetAck(message)) {
 			// only process if not ACK
 			if (command == C_INTERNAL) {
 				// Process signing related internal messages
-				if (signerProcessInternal(_msg)) {
+				if (signerProcessInternal(message)) {
 					return; // Signer processing indicated no further action needed
 				}
 #if !defined(MY_GATEWAY_FEATURE)
 				if (type == I_ID_RESPONSE) {
 #if (MY_NODE_ID == AUTO)
 					// only active if node ID dynamic
-					(void)transportAssignNodeID(_msg.getByte());
+					(void)transportAssignNodeID(message.getByte());
 #endif
 					return; // no further processing required
 				}
@@ -678,7 +706,7 @@ void transportProcessMessage(void)
 #if !defined(MY_GATEWAY_FEATURE) && !defined(MY_PARENT_NODE_IS_STATIC)
 					if (_transportSM.findingParentNode) {	// only process if find parent active
 						// Reply to a I_FIND_PARENT_REQUEST message. Check if the distance is shorter than we already have.
-						uint8_t distance = _msg.getByte();
+						uint8_t distance = message.getByte();
 						if (isValidDistance(distance)) {
 							distance++;	// Distance to gateway is one more for us w.r.t. parent
 							// update settings if distance shorter or preferred parent found
@@ -704,7 +732,7 @@ void transportProcessMessage(void)
 #endif
 				// general
 				if (type == I_PING) {
-					TRANSPORT_DEBUG(PSTR("TSF:MSG:PINGED,ID=%d,HP=%d\n"), sender, _msg.getByte()); // node pinged
+					TRANSPORT_DEBUG(PSTR("TSF:MSG:PINGED,ID=%d,HP=%d\n"), sender, message.getByte()); // node pinged
 #if defined(MY_GATEWAY_FEATURE) && (F_CPU>16000000)
 					// delay for fast GW and slow nodes
 					delay(5);
@@ -716,21 +744,26 @@ void transportProcessMessage(void)
 				if (type == I_PONG) {
 					if (_transportSM.pingActive) {
 						_transportSM.pingActive = false;
-						_transportSM.pingResponse = _msg.getByte();
+						_transportSM.pingResponse = message.getByte();
 						TRANSPORT_DEBUG(PSTR("TSF:MSG:PONG RECV,HP=%d\n"), _transportSM.pingResponse); // pong received
 					} else {
 						TRANSPORT_DEBUG(PSTR("!TSF:MSG:PONG RECV,INACTIVE\n")); // pong received, but !pingActive
 					}
 					return; // no further processing required
 				}
-				if (_processInternalMessages()) {
+				if (_processInternalMessages(message)) {
 					return; // no further processing required
 				}
 			} else if (command == C_STREAM) {
 #if defined(MY_OTA_FIRMWARE_FEATURE)
-				if(firmwareOTAUpdateProcess()) {
+				if(firmwareOTAUpdateProcess(message)) {
 					return; // OTA FW update processing indicated no further action needed
 				}
+#endif
+#if defined(MY_OTA_FIRMWARE_SERVER)
+				if (firmwareServerProcess(message)) {
+					return; // FW request answered by the gateway, no further action needed
+				}
 #endif
 			}
 		} else {
@@ -739,11 +772,11 @@ void transportProcessMessage(void)
 		}
 #if defined(MY_GATEWAY_FEATURE)
 		// Hand over message to controller
-		(void)gatewayTransportSend(_msg);
+		(void)gatewayTransportSend(message);
 #endif
 		// Call incoming message callback if available
 		if (receive) {
-			receive(_msg);
+			receive(message);
 		}
 	} else if (destination == BROADCAST_ADDRESS) {
 		TRANSPORT_DEBUG(PSTR("TSF:MSG:BC\n"));	// broadcast msg
@@ -792,7 +825,7 @@ void transportProcessMessage(void)
 		if(last == _transportConfig.parentNodeId && sender != _transportConfig.nodeId &&
 		        isTransportReady()) {
 			TRANSPORT_DEBUG(PSTR("TSF:MSG:FWD BC MSG\n")); // controlled broadcast msg forwarding
-			(void)transportRouteMessage(_msg);
+			(void)transportRouteMessage(message);
 		}
 #endif
 
@@ -804,12 +837,19 @@ void transportProcessMessage(void)
 				return;
 			}
 #endif
+#if defined(MY_OTA_MULTICAST)
+			// FW blocks broadcast to all nodes updating the same firmware
+			if (command == C_STREAM && type == ST_FIRMWARE_RESPONSE && isFirmwareUpdateOngoing() &&
+			        firmwareOTAUpdateProcess(message)) {
+				return; // OTA FW update processing indicated no further action needed
+			}
+#endif
 #if defined(MY_GATEWAY_FEATURE)
 			// Hand over message to controller
-			(void)gatewayTransportSend(_msg);
+			(void)gatewayTransportSend(message);
 #endif
 			if (receive) {
-				receive(_msg);
+				receive(message);
 			}
 		}
 
@@ -820,16 +860,16 @@ void transportProcessMessage(void)
 			TRANSPORT_DEBUG(PSTR("TSF:MSG:REL MSG\n"));	// relay msg
 			if (command == C_INTERNAL) {
 				if (type == I_PING || type == I_PONG) {
-					uint8_t hopsCnt = _msg.getByte();
+					uint8_t hopsCnt = message.getByte();
 					if (hopsCnt != MAX_HOPS) {
 						TRANSPORT_DEBUG(PSTR("TSF:MSG:REL PxNG,HP=%d\n"), hopsCnt);
 						hopsCnt++;
-						_msg.set(hopsCnt);
+						message.set(hopsCnt);
 					}
 				}
 			}
 			// Relay this message to another node
-			(void)transportRouteMessage(_msg);
+			(void)transportRouteMessage(message);
 		}
 #else
 		TRANSPORT_DEBUG(PSTR("!TSF:MSG:REL MSG,NREP\n"));	// message relaying request, but not a repeater
@@ -861,6 +901,9 @@ void transportProcessFIFO(void)
 	}
 #endif
 
+	// Manage signing timeout
+	(void)signerCheckTimer();
+
 	uint8_t _processedMessages = MAX_SUBSEQ_MSGS;
 	// process all msgs in FIFO or counter exit
 	while (transportAvailable() && _processedMessages--) {
@@ -890,7 +933,14 @@ bool transportSendWrite(const uint8_t to, MyMessage &message)
 
 	// send
 	setIndication(INDICATION_TX);
+#if defined(MY_TRANSPORT_ENCRYPTION)
+	uint8_t frame[MAX_MESSAGE_LENGTH];
+	const uint8_t frameLength = transportEncryptFrame(frame, (uint8_t *)&message,
+	                            min((uint8_t)MAX_MESSAGE_LENGTH, totalMsgLength));
+	bool result = frameLength && transportSend(to, frame, frameLength);
+#else
 	bool result = transportSend(to, &message, min((uint8_t)MAX_MESSAGE_LENGTH, totalMsgLength));
+#endif
 	// broadcasting (workaround counterfeits)
 	result |= (to == BROADCAST_ADDRESS);
 
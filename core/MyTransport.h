@@ -116,6 +116,7 @@
 * |!| TSF	| RTE		| FPAR ACTIVE			| Finding parent active, message not sent
 * |!| TSF	| RTE		| DST %%d UNKNOWN		| Routing for destination (DST) unknown, send message to parent
 * |!| TSF	| SND		| TNR					| Transport not ready, message cannot be sent
+* |!| TSF	| SND		| NACK,TO=%%d			| GW downlink sent in the background to (TO) got no radio ACK (MY_RFM69_GW_BACKGROUND_SEND)
 *
 * Incoming / outgoing messages:
 *
@@ -197,9 +198,6 @@ extern char _convBuf[MAX_PAYLOAD * 2 + 1];
 
 // RX queue
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
-#if defined(MY_RADIO_RFM69)
-#error Receive message buffering not supported for RFM69!
-#endif
 #if defined(MY_RS485)
 #error Receive message buffering not supported for RS485!
 #endif
@@ -343,6 +341,12 @@ void transportProcessFIFO(void);
 */
 void transportProcessMessage(void);
 /**
+* @brief Process a received message
+* @param message received message, processed and relayed in place
+* @param payloadLength length of the received frame
+*/
+void transportProcessReceived(MyMessage &message, uint8_t payloadLength);
+/**
 * @brief Assign node ID
 * @param newNodeId New node ID
 * @return true if node ID is valid and successfully assigned
@@ -516,6 +520,23 @@ bool transportSanityCheck(void);
 * @return length of recevied message (header + payload)
 */
 uint8_t transportReceive(void* data);
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+/**
+* @brief Oldest message in the RX queue not handed out yet, stays queued until released
+*
+* Messages can be peeked again while one is processed, e.g. while waiting for a reply.
+* @param len length of the message (header + payload)
+* @return message, with room for the null terminator of the payload, NULL if none
+*/
+void* transportPeek(uint8_t* len);
+/**
+* @brief Release a message handed out by transportPeek()
+*
+* The queue space is freed once the messages received before are released too.
+* @param data message
+*/
+void transportRelease(void* data);
+#endif
 /**
 * @brief Power down transport HW
 */
@@ -0,0 +1,259 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include "MyTransportEncryption.h"
+#include "MyTransport.h"
+#include "drivers/AES/AES.h"
+
+#define TRANSPORT_ENCRYPTION_COUNTER_RESERVE (256u) // Frames sent between two EEPROM updates of the frame counter
+#define TRANSPORT_ENCRYPTION_RX_RESERVE      (16u)  // Frames accepted from a neighbour between two EEPROM updates of its counter
+#define TRANSPORT_ENCRYPTION_CCM_L           (2u)   // Size of the CCM length field, leaves a 13 byte nonce
+
+#if defined(E2END)
+static_assert(EEPROM_TRANSPORT_ENCRYPTION_PEERS_ADDRESS + MY_TRANSPORT_ENCRYPTION_MAX_NODES *
+              SIZE_TRANSPORT_ENCRYPTION_PEER <= E2END + 1u,
+              "MY_TRANSPORT_ENCRYPTION_MAX_NODES neighbours do not fit into the EEPROM");
+#else
+static_assert(EEPROM_TRANSPORT_ENCRYPTION_PEERS_ADDRESS + MY_TRANSPORT_ENCRYPTION_MAX_NODES *
+              SIZE_TRANSPORT_ENCRYPTION_PEER <= 1024u,
+              "MY_TRANSPORT_ENCRYPTION_MAX_NODES neighbours do not fit into the EEPROM");
+#endif
+
+// Highest frame counter accepted from a neighbour, the entry is kept in EEPROM as node ID and
+// the inverted reserved counter
+typedef struct {
+	uint8_t nodeId;    // Transmitting node (AUTO if unused)
+	uint32_t counter;  // Frame counter of the last frame accepted from the node
+	uint32_t reserved; // Frame counter in EEPROM, frames up to it are rejected after a restart
+} transportEncryptionPeer_t;
+
+static AES _encryptionAes;
+static uint32_t _encryptionTxCounter;  // Frame counter of the next frame sent
+static uint32_t _encryptionTxReserved; // First frame counter not covered by the value in EEPROM
+static transportEncryptionPeer_t _encryptionPeers[MY_TRANSPORT_ENCRYPTION_MAX_NODES];
+
+// Helper to build a CCM block: flags, nonce (transmitting node and frame counter) and a 16-bit value,
+// the payload length for B0 or the block index for the counter blocks
+static void transportEncryptionBlock(uint8_t* block, const uint8_t flags, const uint8_t nodeId,
+                                     const uint32_t counter, const uint16_t value)
+{
+	block[0] = flags;
+	block[1] = nodeId;
+	block[2] = counter >> 24;
+	block[3] = counter >> 16;
+	block[4] = counter >> 8;
+	block[5] = counter;
+	(void)memset(&block[6], 0, 8);
+	block[14] = value >> 8;
+	block[15] = value;
+}
+
+// Helper to encrypt or decrypt the payload of a frame in counter mode
+static void transportEncryptionCtr(uint8_t* payload, const uint8_t length, const uint8_t nodeId,
+                                   const uint32_t counter)
+{
+	uint8_t keystream[N_BLOCK];
+	for (uint8_t offset = 0, index = 1; offset < length; offset += N_BLOCK, index++) {
+		transportEncryptionBlock(keystream, TRANSPORT_ENCRYPTION_CCM_L - 1, nodeId, counter, index);
+		(void)_encryptionAes.encrypt(keystream, keystream);
+		for (uint8_t i = 0; i < N_BLOCK && offset + i < length; i++) {
+			payload[offset + i] ^= keystream[i];
+		}
+	}
+}
+
+// Helper to calculate the CCM MAC of a frame, the header is the associated data
+static void transportEncryptionMac(const uint8_t* frame, const uint8_t length, const uint8_t nodeId,
+                                   const uint32_t counter, uint8_t* mac)
+{
+	const uint8_t* payload = frame + HEADER_SIZE;
+	const uint8_t payloadLength = length - HEADER_SIZE;
+	uint8_t x[N_BLOCK];
+	// B0
+	transportEncryptionBlock(x, 0x40 | (((TRANSPORT_ENCRYPTION_MAC_SIZE - 2) / 2) << 3) |
+	                         (TRANSPORT_ENCRYPTION_CCM_L - 1), nodeId, counter, payloadLength);
+	(void)_encryptionAes.encrypt(x, x);
+	// Associated data, prefixed with its 16-bit length, fits into one block
+	x[1] ^= HEADER_SIZE;
+	for (uint8_t i = 0; i < HEADER_SIZE; i++) {
+		x[2 + i] ^= frame[i];
+	}
+	(void)_encryptionAes.encrypt(x, x);
+	for (uint8_t offset = 0; offset < payloadLength; offset += N_BLOCK) {
+		for (uint8_t i = 0; i < N_BLOCK && offset + i < payloadLength; i++) {
+			x[i] ^= payload[offset + i];
+		}
+		(void)_encryptionAes.encrypt(x, x);
+	}
+	// The MAC is encrypted with counter block 0
+	uint8_t s0[N_BLOCK];
+	transportEncryptionBlock(s0, TRANSPORT_ENCRYPTION_CCM_L - 1, nodeId, counter, 0);
+	(void)_encryptionAes.encrypt(s0, s0);
+	for (uint8_t i = 0; i < TRANSPORT_ENCRYPTION_MAC_SIZE; i++) {
+		mac[i] = x[i] ^ s0[i];
+	}
+}
+
+// Helper to persist the end of the next block of frame counters. After a reset, sending continues
+// there, so a frame counter is never used twice. The value is stored inverted, so that an erased
+// EEPROM reads as 0.
+static void transportEncryptionReserve(void)
+{
+	_encryptionTxReserved = (_encryptionTxReserved > 0xFFFFFFFFul - TRANSPORT_ENCRYPTION_COUNTER_RESERVE) ?
+	                        0xFFFFFFFFul : _encryptionTxReserved + TRANSPORT_ENCRYPTION_COUNTER_RESERVE;
+	const uint32_t stored = ~_encryptionTxReserved;
+	hwWriteConfigBlock((void*)&stored, (void*)EEPROM_TRANSPORT_ENCRYPTION_COUNTER_ADDRESS,
+	                   SIZE_TRANSPORT_ENCRYPTION_COUNTER);
+}
+
+// Helper to persist the frame counter of a neighbour ahead of the one accepted. After a reset,
+// frames up to the stored value are rejected, so an accepted frame is never accepted again.
+static void transportEncryptionReservePeer(const uint8_t index)
+{
+	transportEncryptionPeer_t* peer = &_encryptionPeers[index];
+	peer->reserved = (peer->counter > 0xFFFFFFFFul - TRANSPORT_ENCRYPTION_RX_RESERVE) ? 0xFFFFFFFFul :
+	                 peer->counter + TRANSPORT_ENCRYPTION_RX_RESERVE;
+	const uint32_t stored = ~peer->reserved;
+	uint8_t entry[SIZE_TRANSPORT_ENCRYPTION_PEER];
+	entry[0] = peer->nodeId;
+	(void)memcpy(&entry[1], &stored, SIZE_TRANSPORT_ENCRYPTION_COUNTER);
+	const uintptr_t address = EEPROM_TRANSPORT_ENCRYPTION_PEERS_ADDRESS + index * SIZE_TRANSPORT_ENCRYPTION_PEER;
+	hwWriteConfigBlock((void*)entry, (void*)address, SIZE_TRANSPORT_ENCRYPTION_PEER);
+}
+
+void transportEncryptionInit(void)
+{
+	uint8_t key[16];
+	hwReadConfigBlock((void*)key, (void*)EEPROM_RF_ENCRYPTION_AES_KEY_ADDRESS, sizeof(key));
+	(void)_encryptionAes.set_key(key, sizeof(key));
+	(void)memset(key, 0, sizeof(key));
+
+	uint32_t stored;
+	hwReadConfigBlock((void*)&stored, (void*)EEPROM_TRANSPORT_ENCRYPTION_COUNTER_ADDRESS,
+	                  SIZE_TRANSPORT_ENCRYPTION_COUNTER);
+	_encryptionTxCounter = ~stored;
+	_encryptionTxReserved = _encryptionTxCounter;
+	transportEncryptionReserve();
+
+	// erased entries read as AUTO, i.e. unused
+	for (uint8_t i = 0; i < MY_TRANSPORT_ENCRYPTION_MAX_NODES; i++) {
+		uint8_t entry[SIZE_TRANSPORT_ENCRYPTION_PEER];
+		const uintptr_t address = EEPROM_TRANSPORT_ENCRYPTION_PEERS_ADDRESS + i * SIZE_TRANSPORT_ENCRYPTION_PEER;
+		hwReadConfigBlock((void*)entry, (void*)address, SIZE_TRANSPORT_ENCRYPTION_PEER);
+		(void)memcpy(&stored, &entry[1], SIZE_TRANSPORT_ENCRYPTION_COUNTER);
+		_encryptionPeers[i].nodeId = entry[0];
+		_encryptionPeers[i].counter = ~stored;
+		_encryptionPeers[i].reserved = ~stored;
+	}
+}
+
+uint8_t transportEncryptFrame(uint8_t* frame, const uint8_t* data, const uint8_t length)
+{
+	if (length < HEADER_SIZE || length > MAX_MESSAGE_LENGTH - TRANSPORT_ENCRYPTION_OVERHEAD) {
+		TRANSPORT_DEBUG(PSTR("!TSF:ENC:LEN,%d\n"), length);	// no room for frame counter and MAC
+		return 0;
+	}
+	const uint8_t nodeId = ((const MyMessage*)data)->last;
+	if (nodeId == AUTO) {
+		TRANSPORT_DEBUG(PSTR("!TSF:ENC:ID\n"));	// nodes without ID would share the nonce
+		return 0;
+	}
+	if (_encryptionTxCounter == 0xFFFFFFFFul) {
+		TRANSPORT_DEBUG(PSTR("!TSF:ENC:CNT\n"));	// frame counter exhausted, never wrap
+		return 0;
+	}
+	if (_encryptionTxCounter == _encryptionTxReserved) {
+		transportEncryptionReserve();
+	}
+	const uint32_t counter = _encryptionTxCounter++;
+
+	(void)memcpy(frame, data, length);
+	uint8_t* trailer = frame + length;
+	trailer[0] = counter;
+	trailer[1] = counter >> 8;
+	trailer[2] = counter >> 16;
+	trailer[3] = counter >> 24;
+	transportEncryptionMac(frame, length, nodeId, counter, trailer + TRANSPORT_ENCRYPTION_COUNTER_SIZE);
+	transportEncryptionCtr(frame + HEADER_SIZE, length - HEADER_SIZE, nodeId, counter);
+	return length + TRANSPORT_ENCRYPTION_OVERHEAD;
+}
+
+uint8_t transportDecryptFrame(uint8_t* frame, const uint8_t length)
+{
+	if (length < HEADER_SIZE + TRANSPORT_ENCRYPTION_OVERHEAD || length > MAX_MESSAGE_LENGTH) {
+		TRANSPORT_DEBUG(PSTR("!TSF:ENC:LEN,%d\n"), length);
+		return 0;
+	}
+	const uint8_t messageLength = length - TRANSPORT_ENCRYPTION_OVERHEAD;
+	const uint8_t* trailer = frame + messageLength;
+	const uint32_t counter = (uint32_t)trailer[0] | ((uint32_t)trailer[1] << 8) |
+	                         ((uint32_t)trailer[2] << 16) | ((uint32_t)trailer[3] << 24);
+	const uint8_t nodeId = ((const MyMessage*)frame)->last;
+	if (nodeId == AUTO) {
+		// never sent, nodes without ID would share the nonce
+		TRANSPORT_DEBUG(PSTR("!TSF:ENC:ID\n"));
+		return 0;
+	}
+
+	// neighbours are never evicted, a node not in the table is only taken while there is room
+	uint8_t index = MY_TRANSPORT_ENCRYPTION_MAX_NODES;
+	bool known = false;
+	for (uint8_t i = 0; i < MY_TRANSPORT_ENCRYPTION_MAX_NODES; i++) {
+		if (_encryptionPeers[i].nodeId == nodeId) {
+			index = i;
+			known = true;
+			break;
+		}
+		if (_encryptionPeers[i].nodeId == AUTO && index == MY_TRANSPORT_ENCRYPTION_MAX_NODES) {
+			index = i;
+		}
+	}
+	if (index == MY_TRANSPORT_ENCRYPTION_MAX_NODES) {
+		TRANSPORT_DEBUG(PSTR("!TSF:ENC:FULL,%d\n"), nodeId);	// no room to track the node
+		return 0;
+	}
+	transportEncryptionPeer_t* peer = &_encryptionPeers[index];
+	if (known && counter <= peer->counter) {
+		TRANSPORT_DEBUG(PSTR("!TSF:ENC:REPLAY,%d,%lu\n"), nodeId, (unsigned long)counter);
+		return 0;
+	}
+
+	transportEncryptionCtr(frame + HEADER_SIZE, messageLength - HEADER_SIZE, nodeId, counter);
+	uint8_t mac[TRANSPORT_ENCRYPTION_MAC_SIZE];
+	transportEncryptionMac(frame, messageLength, nodeId, counter, mac);
+	uint8_t diff = 0;
+	for (uint8_t i = 0; i < TRANSPORT_ENCRYPTION_MAC_SIZE; i++) {
+		diff |= mac[i] ^ trailer[TRANSPORT_ENCRYPTION_COUNTER_SIZE + i];
+	}
+	if (diff) {
+		TRANSPORT_DEBUG(PSTR("!TSF:ENC:MAC,%d\n"), nodeId);
+		return 0;
+	}
+
+	if (!known) {
+		// first frame of the node, tracked from now on
+		TRANSPORT_DEBUG(PSTR("TSF:ENC:NEW,%d\n"), nodeId);
+		peer->nodeId = nodeId;
+	}
+	peer->counter = counter;
+	if (!known || counter >= peer->reserved) {
+		transportEncryptionReservePeer(index);
+	}
+	return messageLength;
+}
@@ -0,0 +1,82 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2015 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+/**
+ * @file MyTransportEncryption.h
+ *
+ * @brief AES-CCM authenticated encryption of transport frames (@ref MY_TRANSPORT_ENCRYPTION)
+ *
+ * Every frame is protected hop by hop with the AES key personalized for RF encryption.
+ * The header is authenticated but left in clear, the payload is encrypted. A 32-bit frame
+ * counter and a 32-bit MAC are appended to the frame:
+ *
+ * | header (7) | encrypted payload (0-17) | frame counter (4) | MAC (4) |
+ *
+ * Payloads set on a message are limited to @ref MAX_TX_PAYLOAD (17) bytes.
+ *
+ * The ID of the transmitting node (last) and its frame counter form the CCM nonce. The counter
+ * is persisted in EEPROM and never reused. Nodes without ID (AUTO) would share nonces, their
+ * frames are neither sent nor accepted, so every node needs a static ID. Receivers only accept
+ * frames with a counter above the last one seen from the same node, which protects against
+ * replay without a nonce round trip.
+ *
+ * The highest counters seen are kept for @ref MY_TRANSPORT_ENCRYPTION_MAX_NODES neighbours
+ * and persisted in EEPROM ahead of the accepted counter, in blocks of 16 frames. After a
+ * restart, frames up to the persisted counter are rejected: a recorded frame is never accepted
+ * twice, and up to 16 new frames of each neighbour are lost. Entries are never reused, frames
+ * of a node not in the table are rejected once it is full. A node is taken into the table with
+ * its first authenticated frame.
+ */
+
+#ifndef MyTransportEncryption_h
+#define MyTransportEncryption_h
+
+#include "MySensorsCore.h"
+
+#define TRANSPORT_ENCRYPTION_COUNTER_SIZE (4u) //!< Size of the frame counter appended to a frame
+#define TRANSPORT_ENCRYPTION_MAC_SIZE     (4u) //!< Size of the truncated CCM MAC appended to a frame
+#define TRANSPORT_ENCRYPTION_OVERHEAD     (TRANSPORT_ENCRYPTION_COUNTER_SIZE + TRANSPORT_ENCRYPTION_MAC_SIZE) //!< Bytes added to every frame
+
+/**
+ * @brief Load the key and restore the frame counter from EEPROM
+ */
+void transportEncryptionInit(void);
+
+/**
+ * @brief Encrypt and authenticate a frame
+ *
+ * @param frame Buffer receiving the protected frame, at least @ref MAX_MESSAGE_LENGTH bytes
+ * @param data Frame to protect, starting with the message header
+ * @param length Length of the frame to protect
+ * @return Length of the protected frame, 0 if the frame is too long, sent without node ID or the frame counter is exhausted
+ */
+uint8_t transportEncryptFrame(uint8_t* frame, const uint8_t* data, const uint8_t length);
+
+/**
+ * @brief Authenticate and decrypt a received frame in place
+ *
+ * Frames failing authentication and frames replaying an old frame counter are rejected.
+ *
+ * @param frame Received frame
+ * @param length Length of the received frame
+ * @return Length of the decrypted frame without counter and MAC, 0 if the frame is rejected
+ */
+uint8_t transportDecryptFrame(uint8_t* frame, const uint8_t length);
+
+#endif
@@ -28,35 +28,183 @@
 #include "drivers/AES/AES.h"
 #endif
 
+#if defined(MY_RF24_ACK_PAYLOAD)
+#if defined(MY_RF24_ENABLE_ENCRYPTION)
+#error MY_RF24_ACK_PAYLOAD cannot be combined with MY_RF24_ENABLE_ENCRYPTION
+#endif
+/** Protocol version of messages preloaded as ACK payload, not used by the protocol */
+#define TRANSPORT_ACK_PAYLOAD_VERSION (PROTOCOL_VERSION + 1u)
+#if PROTOCOL_VERSION >= 3
+#error No protocol version left to tag ACK payloads
+#endif
+
+static uint8_t transportAckPayloadAccept(uint8_t* data, const uint8_t len)
+{
+	// Any child sending to this node may get the ACK carrying the payload. Only the destination
+	// takes it, a repeater would relay a message to somebody else.
+	MyMessage* msg = (MyMessage*)data;
+	if (len < HEADER_SIZE || mGetVersion((*msg)) != TRANSPORT_ACK_PAYLOAD_VERSION) {
+		return len;
+	}
+	if (msg->destination != RF24_getNodeID()) {
+		return 0;
+	}
+	mSetVersion((*msg), PROTOCOL_VERSION);
+	return len;
+}
+
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+/** Message to a neighbour that could not be delivered directly, 0 length if none */
+static uint8_t transportAckPayloadTo;
+static uint8_t transportAckPayloadLength = 0;
+static uint8_t transportAckPayloadData[MAX_MESSAGE_LENGTH];
+
+/** State of the preloaded ACK payload, advanced by the IRQ handler */
+typedef enum {
+	TRANSPORT_ACK_PAYLOAD_NONE,			//!< Not loaded
+	TRANSPORT_ACK_PAYLOAD_LOADED,		//!< Loaded, messages received from its destination only
+	TRANSPORT_ACK_PAYLOAD_MIXED,		//!< Loaded, messages received from other nodes too
+	TRANSPORT_ACK_PAYLOAD_DELIVERED,	//!< Sent with the ACK of a message of the destination
+	TRANSPORT_ACK_PAYLOAD_MISSED		//!< Sent, the ACK may have gone to another node
+} transportAckPayloadState_t;
+static uint8_t transportAckPayloadState = TRANSPORT_ACK_PAYLOAD_NONE;
+
+static bool transportAckPayloadTransition(uint8_t from, const uint8_t to)
+{
+#if defined(__AVR__)
+	bool result = false;
+	MY_CRITICAL_SECTION {
+		if (transportAckPayloadState == from) {
+			transportAckPayloadState = to;
+			result = true;
+		}
+	}
+	return result;
+#else
+	return __atomic_compare_exchange_n(&transportAckPayloadState, &from, to, false, __ATOMIC_ACQ_REL,
+	                                   __ATOMIC_ACQUIRE);
+#endif
+}
+
+static uint8_t transportAckPayloadTake(void)
+{
+	// returns the state and unloads, the caller flushes the TX FIFO
+#if defined(__AVR__)
+	uint8_t state;
+	MY_CRITICAL_SECTION {
+		state = transportAckPayloadState;
+		transportAckPayloadState = TRANSPORT_ACK_PAYLOAD_NONE;
+	}
+	return state;
+#else
+	return __atomic_exchange_n(&transportAckPayloadState, (uint8_t)TRANSPORT_ACK_PAYLOAD_NONE,
+	                           __ATOMIC_ACQ_REL);
+#endif
+}
+
+static void transportAckPayloadReceived(const uint8_t* data, const uint8_t len)
+{
+	// From interrupt context, for each message read. The payload goes out with the ACK of the first
+	// message received after loading, a message of another node makes the receiver uncertain.
+	const MyMessage* msg = (const MyMessage*)data;
+	if (len >= HEADER_SIZE && msg->destination != BROADCAST_ADDRESS &&
+	        msg->last != transportAckPayloadTo) {
+		(void)transportAckPayloadTransition(TRANSPORT_ACK_PAYLOAD_LOADED, TRANSPORT_ACK_PAYLOAD_MIXED);
+	}
+}
+
+static void transportAckPayloadSent(void)
+{
+	// From interrupt context on TX_DS, after the messages received with it were read
+	if (!transportAckPayloadTransition(TRANSPORT_ACK_PAYLOAD_LOADED,
+	                                   TRANSPORT_ACK_PAYLOAD_DELIVERED)) {
+		(void)transportAckPayloadTransition(TRANSPORT_ACK_PAYLOAD_MIXED, TRANSPORT_ACK_PAYLOAD_MISSED);
+	}
+}
+
+static void transportAckPayloadUpdate(const uint8_t state)
+{
+	if (state == TRANSPORT_ACK_PAYLOAD_DELIVERED) {
+		transportAckPayloadLength = 0;
+	}
+	// else not sent yet or possibly to another neighbour, which drops it; preload again
+	if (transportAckPayloadLength) {
+		// loaded before writing, a message received in between only makes the receiver uncertain
+		(void)transportAckPayloadTransition(TRANSPORT_ACK_PAYLOAD_NONE, TRANSPORT_ACK_PAYLOAD_LOADED);
+		RF24_writeAckPayload(transportAckPayloadData, transportAckPayloadLength);
+	}
+}
+
+static void transportAckPayloadPoll(void)
+{
+#if defined(__AVR__)
+	const uint8_t state = *(volatile uint8_t*)&transportAckPayloadState;
+#else
+	const uint8_t state = __atomic_load_n(&transportAckPayloadState, __ATOMIC_ACQUIRE);
+#endif
+	if (state == TRANSPORT_ACK_PAYLOAD_DELIVERED || state == TRANSPORT_ACK_PAYLOAD_MISSED ||
+	        (state == TRANSPORT_ACK_PAYLOAD_NONE && transportAckPayloadLength)) {
+		transportAckPayloadUpdate(transportAckPayloadTake());
+	}
+}
+#endif
+#endif
+
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
 typedef struct _transportQueuedMessage {
 	uint8_t m_len;                        // Length of the data
-	uint8_t m_data[MAX_MESSAGE_LENGTH];   // The raw data
+	bool m_released;                      // Processed, dequeued with the messages before it
+	uint8_t m_data[sizeof(MyMessage)];    // The raw data, processed in place
 } transportQueuedMessage;
 
-/** Buffer to store queued messages in. */
-static transportQueuedMessage transportRxQueueStorage[MY_RX_MESSAGE_BUFFER_SIZE];
-/** Circular buffer, which uses the transportRxQueueStorage and administers stored messages. */
-static CircularBuffer<transportQueuedMessage> transportRxQueue(transportRxQueueStorage,
-        MY_RX_MESSAGE_BUFFER_SIZE);
+/** Circular buffer of queued messages, filled from interrupt context. */
+static CircularBuffer<transportQueuedMessage, MY_RX_MESSAGE_BUFFER_SIZE> transportRxQueue;
+/** Messages handed out by transportPeek() and not dequeued yet, the oldest messages queued. */
+static size_t transportRxPeeked = 0;
 
-static volatile uint8_t transportLostMessageCount = 0;
+/** Messages discarded because the queue was full, max 255. Written from interrupt context. */
+static uint8_t transportLostMessageCount = 0;
+
+static void transportCountLostMessage(void)
+{
+#if defined(__AVR__)
+	MY_CRITICAL_SECTION {
+		if (transportLostMessageCount < 255) {
+			++transportLostMessageCount;
+		}
+	}
+#else
+	// saturating increment, safe against readers in the main thread
+	uint8_t count = __atomic_load_n(&transportLostMessageCount, __ATOMIC_RELAXED);
+	while (count < 255 &&
+	        !__atomic_compare_exchange_n(&transportLostMessageCount, &count, count + 1, true,
+	                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+#endif
+}
 
 static void transportRxCallback(void)
 {
 	// Called for each message received by radio, from interrupt context.
 	// This function _must_ call RF24_readMessage() to de-assert interrupt line!
-	if (!transportRxQueue.full()) {
-		transportQueuedMessage* msg = transportRxQueue.getFront();
+	transportQueuedMessage* msg = transportRxQueue.getFront();
+	if (msg) {
 		msg->m_len = RF24_readMessage(msg->m_data);		// Read payload & clear RX_DR
+		msg->m_released = false;
+#if defined(MY_RF24_ACK_PAYLOAD)
+		transportAckPayloadReceived(msg->m_data, msg->m_len);
+		msg->m_len = transportAckPayloadAccept(msg->m_data, msg->m_len);
+		if (!msg->m_len) {
+			// ACK payload for another node
+			return;
+		}
+#endif
 		(void)transportRxQueue.pushFront(msg);
 	} else {
 		// Queue is full. Discard message.
 		(void)RF24_readMessage(NULL);		// Read payload & clear RX_DR
-		// Keep track of messages lost. Max 255, prevent wrapping.
-		if (transportLostMessageCount < 255) {
-			++transportLostMessageCount;
-		}
+		// Keep track of messages lost
+		transportCountLostMessage();
 	}
 }
 #endif
@@ -79,6 +227,9 @@ bool transportInit(void)
 
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
 	RF24_registerReceiveCallback( transportRxCallback );
+#if defined(MY_RF24_ACK_PAYLOAD)
+	RF24_registerAckPayloadSentCallback( transportAckPayloadSent );
+#endif
 #endif
 	return RF24_initialize();
 }
@@ -105,6 +256,20 @@ bool transportSend(const uint8_t to, const void* data, const uint8_t len)
 	//encrypt data
 	_aes.cbc_encrypt(_dataenc, _dataenc, finalLength /16);
 	return RF24_sendMessage(to, _dataenc, finalLength);
+#elif defined(MY_RF24_ACK_PAYLOAD) && defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	// sending flushes the TX FIFO
+	const uint8_t state = transportAckPayloadTake();
+	const bool result = RF24_sendMessage(to, data, len);
+	if (!result && to != BROADCAST_ADDRESS && ((const MyMessage*)data)->destination == to) {
+		// neighbour not listening, e.g. sleeping: hand the message over with the ACK of its next
+		// message. Replaces a message still pending.
+		(void)memcpy(transportAckPayloadData, data, len);
+		mSetVersion((*(MyMessage*)transportAckPayloadData), TRANSPORT_ACK_PAYLOAD_VERSION);
+		transportAckPayloadTo = to;
+		transportAckPayloadLength = len;
+	}
+	transportAckPayloadUpdate(state);
+	return result;
 #else
 	return RF24_sendMessage(to, data, len);
 #endif
@@ -112,9 +277,12 @@ bool transportSend(const uint8_t to, const void* data, const uint8_t len)
 
 bool transportAvailable(void)
 {
+#if defined(MY_RF24_ACK_PAYLOAD) && defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	transportAckPayloadPoll();
+#endif
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
 	(void)RF24_isDataAvailable;				// Prevent 'defined but not used' warning
-	return !transportRxQueue.empty();
+	return transportRxQueue.available() > transportRxPeeked;
 #else
 	return RF24_isDataAvailable();
 #endif
@@ -125,19 +293,8 @@ bool transportSanityCheck(void)
 	return RF24_sanityCheck();
 }
 
-uint8_t transportReceive(void* data)
+static uint8_t transportDecrypt(void* data, uint8_t len)
 {
-	uint8_t len = 0;
-#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
-	transportQueuedMessage* msg = transportRxQueue.getBack();
-	if (msg) {
-		len = msg->m_len;
-		(void)memcpy(data, msg->m_data, len);
-		(void)transportRxQueue.popBack();
-	}
-#else
-	len = RF24_readMessage(data);
-#endif
 #if defined(MY_RF24_ENABLE_ENCRYPTION)
 	// has to be adjusted, WIP!
 	_aes.set_IV(0);
@@ -145,10 +302,57 @@ uint8_t transportReceive(void* data)
 	if (_aes.cbc_decrypt((uint8_t*)(data), (uint8_t*)(data), len > 16 ? 2 : 1) != AES_SUCCESS) {
 		len = 0;
 	}
+#else
+	(void)data;
 #endif
 	return len;
 }
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+void* transportPeek(uint8_t* len)
+{
+	// messages before it are still processed if processing nests
+	transportQueuedMessage* msg = transportRxQueue.getBack(transportRxPeeked);
+	if (!msg) {
+		return NULL;
+	}
+	transportRxPeeked++;
+	*len = transportDecrypt(msg->m_data, msg->m_len);
+	return msg->m_data;
+}
+
+void transportRelease(void* data)
+{
+	transportQueuedMessage* msg = (transportQueuedMessage*)((uint8_t*)data - offsetof(
+	                                  transportQueuedMessage, m_data));
+	msg->m_released = true;
+	// dequeue in order, the space of a message is freed once the older ones are released too
+	while (transportRxPeeked && (msg = transportRxQueue.getBack()) != NULL && msg->m_released) {
+		(void)transportRxQueue.popBack();
+		transportRxPeeked--;
+	}
+}
+#endif
+
+uint8_t transportReceive(void* data)
+{
+	uint8_t len = 0;
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	void* msg = transportPeek(&len);
+	if (msg) {
+		(void)memcpy(data, msg, len);
+		transportRelease(msg);
+	}
+	return len;
+#else
+	len = RF24_readMessage(data);
+#if defined(MY_RF24_ACK_PAYLOAD)
+	len = transportAckPayloadAccept((uint8_t*)data, len);
+#endif
+	return transportDecrypt(data, len);
+#endif
+}
+
 void transportPowerDown(void)
 {
 	RF24_powerDown();
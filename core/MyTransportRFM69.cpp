@@ -25,6 +25,20 @@
 RFM69 _radio(MY_RF69_SPI_CS, MY_RF69_IRQ_PIN, MY_RFM69HW, MY_RF69_IRQ_NUM);
 uint8_t _address;
 
+#if defined(MY_GATEWAY_FEATURE) && defined(MY_RFM69_GW_BACKGROUND_SEND)
+/** Set while the send in progress was started in the background */
+static bool transportSendBackground = false;
+
+static void transportSendDone(const uint8_t to, const bool success)
+{
+	(void)to;	// debug output only
+	// blocking sends return the result instead
+	if (transportSendBackground && !success) {
+		setIndication(INDICATION_ERR_TX);
+		TRANSPORT_DEBUG(PSTR("!TSF:SND:NACK,TO=%d\n"), to);
+	}
+}
+#endif
 
 bool transportInit(void)
 {
@@ -35,6 +49,9 @@ bool transportInit(void)
 		hwReadConfigBlock((void*)_psk, (void*)EEPROM_RF_ENCRYPTION_AES_KEY_ADDRESS, 16);
 		_radio.encrypt((const char*)_psk);
 		memset(_psk, 0, 16); // Make sure it is purged from memory when set
+#endif
+#if defined(MY_GATEWAY_FEATURE) && defined(MY_RFM69_GW_BACKGROUND_SEND)
+		_radio.setSendCallback(transportSendDone);
 #endif
 		return true;
 	}
@@ -54,12 +71,32 @@ uint8_t transportGetAddress(void)
 
 bool transportSend(const uint8_t to, const void* data, const uint8_t len)
 {
+#if defined(MY_GATEWAY_FEATURE) && defined(MY_RFM69_GW_BACKGROUND_SEND)
+	// complete the previous downlink
+	while (_radio.sendProcess()) {
+		doYield();
+	}
+	transportSendBackground = !mGetRequestAck((*(const MyMessage*)data));
+	if (transportSendBackground) {
+		// the GW only indicates failed downlinks: the send completes in the background,
+		// driven by transportAvailable(), and transportSendDone() reports a missing ACK
+		return _radio.sendStart(to, data, len);
+	}
+#endif
+	// wait for the ACK: nodes count failed uplinks, a requested ACK needs the result
 	return _radio.sendWithRetry(to,data,len);
 }
 
 bool transportAvailable(void)
 {
+#if defined(MY_GATEWAY_FEATURE) && defined(MY_RFM69_GW_BACKGROUND_SEND)
+	(void)_radio.sendProcess();
+#endif
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	return _radio.available();
+#else
 	return _radio.receiveDone();
+#endif
 }
 
 bool transportSanityCheck(void)
@@ -68,6 +105,29 @@ bool transportSanityCheck(void)
 	return true;
 }
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+uint8_t transportReceive(void* data)
+{
+	uint8_t len = 0;
+	uint8_t* payload = _radio.peek(&len);
+	if (payload == NULL) {
+		return 0;
+	}
+	memcpy(data, (const void *)payload, len);
+	_radio.release(payload);
+	return len;
+}
+
+void* transportPeek(uint8_t* len)
+{
+	return _radio.peek(len);
+}
+
+void transportRelease(void* data)
+{
+	_radio.release((uint8_t*)data);
+}
+#else
 uint8_t transportReceive(void* data)
 {
 	memcpy(data,(const void *)_radio.DATA, _radio.DATALEN);
@@ -79,8 +139,14 @@ uint8_t transportReceive(void* data)
 	}
 	return dataLen;
 }
+#endif
 
 void transportPowerDown(void)
 {
+#if defined(MY_GATEWAY_FEATURE) && defined(MY_RFM69_GW_BACKGROUND_SEND)
+	while (_radio.sendProcess()) {
+		doYield();
+	}
+#endif
 	_radio.sleep();
 }
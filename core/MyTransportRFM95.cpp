@@ -62,6 +62,18 @@ uint8_t transportReceive(void* data)
 	return RFM95_recv((uint8_t*)data);
 }
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+void* transportPeek(uint8_t* len)
+{
+	return RFM95_peek(len);
+}
+
+void transportRelease(void* data)
+{
+	RFM95_release((uint8_t*)data);
+}
+#endif
+
 void transportPowerDown(void)
 {
 	(void)RFM95_sleep();
@@ -131,6 +131,7 @@ static void xor_block (byte * d, byte * s)
 	}
 }
 
+#if !defined(AES_TTABLE)
 static void copy_and_key (byte * d, byte * s, byte * k)
 {
 	for (byte i = 0 ; i < N_BLOCK ; i += 4) {
@@ -242,6 +243,272 @@ static void inv_mix_sub_columns (byte dt[N_BLOCK], byte st[N_BLOCK])
 		dt[(i+15)&15] = is_box (a9^a2  ^  bc^b1  ^  c9     ^  dc^d2) ;
 	}
 }
+#endif
+
+#if defined(AES_TTABLE)
+/* Word oriented engine. A state column is held in a 32-bit word with row 0 in
+   the low byte, so the tables are valid for little and big endian cpus alike.
+   t_fwd [x] is the mix columns contribution of s_box (x) in row 0, t_inv [x]
+   the inverse mix columns contribution of is_box (x). The other rows use the
+   same tables rotated by 8, 16 and 24 bits. */
+
+const static uint32_t t_fwd [0x100] PROGMEM = {
+	0xa56363c6, 0x847c7cf8, 0x997777ee, 0x8d7b7bf6, 0x0df2f2ff, 0xbd6b6bd6, 0xb16f6fde, 0x54c5c591,
+	0x50303060, 0x03010102, 0xa96767ce, 0x7d2b2b56, 0x19fefee7, 0x62d7d7b5, 0xe6abab4d, 0x9a7676ec,
+	0x45caca8f, 0x9d82821f, 0x40c9c989, 0x877d7dfa, 0x15fafaef, 0xeb5959b2, 0xc947478e, 0x0bf0f0fb,
+	0xecadad41, 0x67d4d4b3, 0xfda2a25f, 0xeaafaf45, 0xbf9c9c23, 0xf7a4a453, 0x967272e4, 0x5bc0c09b,
+	0xc2b7b775, 0x1cfdfde1, 0xae93933d, 0x6a26264c, 0x5a36366c, 0x413f3f7e, 0x02f7f7f5, 0x4fcccc83,
+	0x5c343468, 0xf4a5a551, 0x34e5e5d1, 0x08f1f1f9, 0x937171e2, 0x73d8d8ab, 0x53313162, 0x3f15152a,
+	0x0c040408, 0x52c7c795, 0x65232346, 0x5ec3c39d, 0x28181830, 0xa1969637, 0x0f05050a, 0xb59a9a2f,
+	0x0907070e, 0x36121224, 0x9b80801b, 0x3de2e2df, 0x26ebebcd, 0x6927274e, 0xcdb2b27f, 0x9f7575ea,
+	0x1b090912, 0x9e83831d, 0x742c2c58, 0x2e1a1a34, 0x2d1b1b36, 0xb26e6edc, 0xee5a5ab4, 0xfba0a05b,
+	0xf65252a4, 0x4d3b3b76, 0x61d6d6b7, 0xceb3b37d, 0x7b292952, 0x3ee3e3dd, 0x712f2f5e, 0x97848413,
+	0xf55353a6, 0x68d1d1b9, 0x00000000, 0x2cededc1, 0x60202040, 0x1ffcfce3, 0xc8b1b179, 0xed5b5bb6,
+	0xbe6a6ad4, 0x46cbcb8d, 0xd9bebe67, 0x4b393972, 0xde4a4a94, 0xd44c4c98, 0xe85858b0, 0x4acfcf85,
+	0x6bd0d0bb, 0x2aefefc5, 0xe5aaaa4f, 0x16fbfbed, 0xc5434386, 0xd74d4d9a, 0x55333366, 0x94858511,
+	0xcf45458a, 0x10f9f9e9, 0x06020204, 0x817f7ffe, 0xf05050a0, 0x443c3c78, 0xba9f9f25, 0xe3a8a84b,
+	0xf35151a2, 0xfea3a35d, 0xc0404080, 0x8a8f8f05, 0xad92923f, 0xbc9d9d21, 0x48383870, 0x04f5f5f1,
+	0xdfbcbc63, 0xc1b6b677, 0x75dadaaf, 0x63212142, 0x30101020, 0x1affffe5, 0x0ef3f3fd, 0x6dd2d2bf,
+	0x4ccdcd81, 0x140c0c18, 0x35131326, 0x2fececc3, 0xe15f5fbe, 0xa2979735, 0xcc444488, 0x3917172e,
+	0x57c4c493, 0xf2a7a755, 0x827e7efc, 0x473d3d7a, 0xac6464c8, 0xe75d5dba, 0x2b191932, 0x957373e6,
+	0xa06060c0, 0x98818119, 0xd14f4f9e, 0x7fdcdca3, 0x66222244, 0x7e2a2a54, 0xab90903b, 0x8388880b,
+	0xca46468c, 0x29eeeec7, 0xd3b8b86b, 0x3c141428, 0x79dedea7, 0xe25e5ebc, 0x1d0b0b16, 0x76dbdbad,
+	0x3be0e0db, 0x56323264, 0x4e3a3a74, 0x1e0a0a14, 0xdb494992, 0x0a06060c, 0x6c242448, 0xe45c5cb8,
+	0x5dc2c29f, 0x6ed3d3bd, 0xefacac43, 0xa66262c4, 0xa8919139, 0xa4959531, 0x37e4e4d3, 0x8b7979f2,
+	0x32e7e7d5, 0x43c8c88b, 0x5937376e, 0xb76d6dda, 0x8c8d8d01, 0x64d5d5b1, 0xd24e4e9c, 0xe0a9a949,
+	0xb46c6cd8, 0xfa5656ac, 0x07f4f4f3, 0x25eaeacf, 0xaf6565ca, 0x8e7a7af4, 0xe9aeae47, 0x18080810,
+	0xd5baba6f, 0x887878f0, 0x6f25254a, 0x722e2e5c, 0x241c1c38, 0xf1a6a657, 0xc7b4b473, 0x51c6c697,
+	0x23e8e8cb, 0x7cdddda1, 0x9c7474e8, 0x211f1f3e, 0xdd4b4b96, 0xdcbdbd61, 0x868b8b0d, 0x858a8a0f,
+	0x907070e0, 0x423e3e7c, 0xc4b5b571, 0xaa6666cc, 0xd8484890, 0x05030306, 0x01f6f6f7, 0x120e0e1c,
+	0xa36161c2, 0x5f35356a, 0xf95757ae, 0xd0b9b969, 0x91868617, 0x58c1c199, 0x271d1d3a, 0xb99e9e27,
+	0x38e1e1d9, 0x13f8f8eb, 0xb398982b, 0x33111122, 0xbb6969d2, 0x70d9d9a9, 0x898e8e07, 0xa7949433,
+	0xb69b9b2d, 0x221e1e3c, 0x92878715, 0x20e9e9c9, 0x49cece87, 0xff5555aa, 0x78282850, 0x7adfdfa5,
+	0x8f8c8c03, 0xf8a1a159, 0x80898909, 0x170d0d1a, 0xdabfbf65, 0x31e6e6d7, 0xc6424284, 0xb86868d0,
+	0xc3414182, 0xb0999929, 0x772d2d5a, 0x110f0f1e, 0xcbb0b07b, 0xfc5454a8, 0xd6bbbb6d, 0x3a16162c,
+} ;
+
+const static uint32_t t_inv [0x100] PROGMEM = {
+	0x50a7f451, 0x5365417e, 0xc3a4171a, 0x965e273a, 0xcb6bab3b, 0xf1459d1f, 0xab58faac, 0x9303e34b,
+	0x55fa3020, 0xf66d76ad, 0x9176cc88, 0x254c02f5, 0xfcd7e54f, 0xd7cb2ac5, 0x80443526, 0x8fa362b5,
+	0x495ab1de, 0x671bba25, 0x980eea45, 0xe1c0fe5d, 0x02752fc3, 0x12f04c81, 0xa397468d, 0xc6f9d36b,
+	0xe75f8f03, 0x959c9215, 0xeb7a6dbf, 0xda595295, 0x2d83bed4, 0xd3217458, 0x2969e049, 0x44c8c98e,
+	0x6a89c275, 0x78798ef4, 0x6b3e5899, 0xdd71b927, 0xb64fe1be, 0x17ad88f0, 0x66ac20c9, 0xb43ace7d,
+	0x184adf63, 0x82311ae5, 0x60335197, 0x457f5362, 0xe07764b1, 0x84ae6bbb, 0x1ca081fe, 0x942b08f9,
+	0x58684870, 0x19fd458f, 0x876cde94, 0xb7f87b52, 0x23d373ab, 0xe2024b72, 0x578f1fe3, 0x2aab5566,
+	0x0728ebb2, 0x03c2b52f, 0x9a7bc586, 0xa50837d3, 0xf2872830, 0xb2a5bf23, 0xba6a0302, 0x5c8216ed,
+	0x2b1ccf8a, 0x92b479a7, 0xf0f207f3, 0xa1e2694e, 0xcdf4da65, 0xd5be0506, 0x1f6234d1, 0x8afea6c4,
+	0x9d532e34, 0xa055f3a2, 0x32e18a05, 0x75ebf6a4, 0x39ec830b, 0xaaef6040, 0x069f715e, 0x51106ebd,
+	0xf98a213e, 0x3d06dd96, 0xae053edd, 0x46bde64d, 0xb58d5491, 0x055dc471, 0x6fd40604, 0xff155060,
+	0x24fb9819, 0x97e9bdd6, 0xcc434089, 0x779ed967, 0xbd42e8b0, 0x888b8907, 0x385b19e7, 0xdbeec879,
+	0x470a7ca1, 0xe90f427c, 0xc91e84f8, 0x00000000, 0x83868009, 0x48ed2b32, 0xac70111e, 0x4e725a6c,
+	0xfbff0efd, 0x5638850f, 0x1ed5ae3d, 0x27392d36, 0x64d90f0a, 0x21a65c68, 0xd1545b9b, 0x3a2e3624,
+	0xb1670a0c, 0x0fe75793, 0xd296eeb4, 0x9e919b1b, 0x4fc5c080, 0xa220dc61, 0x694b775a, 0x161a121c,
+	0x0aba93e2, 0xe52aa0c0, 0x43e0223c, 0x1d171b12, 0x0b0d090e, 0xadc78bf2, 0xb9a8b62d, 0xc8a91e14,
+	0x8519f157, 0x4c0775af, 0xbbdd99ee, 0xfd607fa3, 0x9f2601f7, 0xbcf5725c, 0xc53b6644, 0x347efb5b,
+	0x7629438b, 0xdcc623cb, 0x68fcedb6, 0x63f1e4b8, 0xcadc31d7, 0x10856342, 0x40229713, 0x2011c684,
+	0x7d244a85, 0xf83dbbd2, 0x1132f9ae, 0x6da129c7, 0x4b2f9e1d, 0xf330b2dc, 0xec52860d, 0xd0e3c177,
+	0x6c16b32b, 0x99b970a9, 0xfa489411, 0x2264e947, 0xc48cfca8, 0x1a3ff0a0, 0xd82c7d56, 0xef903322,
+	0xc74e4987, 0xc1d138d9, 0xfea2ca8c, 0x360bd498, 0xcf81f5a6, 0x28de7aa5, 0x268eb7da, 0xa4bfad3f,
+	0xe49d3a2c, 0x0d927850, 0x9bcc5f6a, 0x62467e54, 0xc2138df6, 0xe8b8d890, 0x5ef7392e, 0xf5afc382,
+	0xbe805d9f, 0x7c93d069, 0xa92dd56f, 0xb31225cf, 0x3b99acc8, 0xa77d1810, 0x6e639ce8, 0x7bbb3bdb,
+	0x097826cd, 0xf418596e, 0x01b79aec, 0xa89a4f83, 0x656e95e6, 0x7ee6ffaa, 0x08cfbc21, 0xe6e815ef,
+	0xd99be7ba, 0xce366f4a, 0xd4099fea, 0xd67cb029, 0xafb2a431, 0x31233f2a, 0x3094a5c6, 0xc066a235,
+	0x37bc4e74, 0xa6ca82fc, 0xb0d090e0, 0x15d8a733, 0x4a9804f1, 0xf7daec41, 0x0e50cd7f, 0x2ff69117,
+	0x8dd64d76, 0x4db0ef43, 0x544daacc, 0xdf0496e4, 0xe3b5d19e, 0x1b886a4c, 0xb81f2cc1, 0x7f516546,
+	0x04ea5e9d, 0x5d358c01, 0x737487fa, 0x2e410bfb, 0x5a1d67b3, 0x52d2db92, 0x335610e9, 0x1347d66d,
+	0x8c61d79a, 0x7a0ca137, 0x8e14f859, 0x893c13eb, 0xee27a9ce, 0x35c961b7, 0xede51ce1, 0x3cb1477a,
+	0x59dfd29c, 0x3f73f255, 0x79ce1418, 0xbf37c773, 0xeacdf753, 0x5baafd5f, 0x146f3ddf, 0x86db4478,
+	0x81f3afca, 0x3ec468b9, 0x2c342438, 0x5f40a3c2, 0x72c31d16, 0x0c25e2bc, 0x8b493c28, 0x41950dff,
+	0x7101a839, 0xdeb30c08, 0x9ce4b4d8, 0x90c15664, 0x6184cb7b, 0x70b632d5, 0x745c6c48, 0x4257b8d0,
+} ;
+
+#define ROTL8(x)  (((x) << 8) | ((x) >> 24))
+#define ROTL16(x) (((x) << 16) | ((x) >> 16))
+#define ROTL24(x) (((x) << 24) | ((x) >> 8))
+#define T_FWD(x)  pgm_read_dword (& t_fwd [(x) & 0xff])
+#define T_INV(x)  pgm_read_dword (& t_inv [(x) & 0xff])
+
+static uint32_t load_column (const byte * b)
+{
+	return (uint32_t) b[0] | ((uint32_t) b[1] << 8) | ((uint32_t) b[2] << 16) | ((uint32_t) b[3] << 24) ;
+}
+
+static void store_column (byte * b, uint32_t w)
+{
+	b[0] = w ;
+	b[1] = w >> 8 ;
+	b[2] = w >> 16 ;
+	b[3] = w >> 24 ;
+}
+
+// inverse mix columns of a round key word, used for the equivalent inverse cipher
+static uint32_t inv_mix_column (uint32_t w)
+{
+	// t_inv [s_box (x)] is the inverse mix columns contribution of x itself
+	return T_INV (s_box (w)) ^ ROTL8 (T_INV (s_box (w >> 8))) ^
+	       ROTL16 (T_INV (s_box (w >> 16))) ^ ROTL24 (T_INV (s_box (w >> 24))) ;
+}
+
+static void ttable_encrypt (const uint32_t * rk, int round, const byte * in, byte * out)
+{
+	uint32_t s0 = load_column (in) ^ rk[0] ;
+	uint32_t s1 = load_column (in + 4) ^ rk[1] ;
+	uint32_t s2 = load_column (in + 8) ^ rk[2] ;
+	uint32_t s3 = load_column (in + 12) ^ rk[3] ;
+	uint32_t t0, t1, t2, t3 ;
+	for (int r = 1 ; r < round ; r++) {
+		rk += N_COL ;
+		t0 = T_FWD (s0) ^ ROTL8 (T_FWD (s1 >> 8)) ^ ROTL16 (T_FWD (s2 >> 16)) ^ ROTL24 (T_FWD (s3 >> 24)) ^ rk[0] ;
+		t1 = T_FWD (s1) ^ ROTL8 (T_FWD (s2 >> 8)) ^ ROTL16 (T_FWD (s3 >> 16)) ^ ROTL24 (T_FWD (s0 >> 24)) ^ rk[1] ;
+		t2 = T_FWD (s2) ^ ROTL8 (T_FWD (s3 >> 8)) ^ ROTL16 (T_FWD (s0 >> 16)) ^ ROTL24 (T_FWD (s1 >> 24)) ^ rk[2] ;
+		t3 = T_FWD (s3) ^ ROTL8 (T_FWD (s0 >> 8)) ^ ROTL16 (T_FWD (s1 >> 16)) ^ ROTL24 (T_FWD (s2 >> 24)) ^ rk[3] ;
+		s0 = t0 ;
+		s1 = t1 ;
+		s2 = t2 ;
+		s3 = t3 ;
+	}
+	rk += N_COL ;
+	// last round without mix columns, the s-box value is byte 1 of t_fwd
+#define FWD_ROUND_LAST(a, b, c, d) \
+	(((T_FWD (a) >> 8) & 0x000000ff) ^ (T_FWD ((b) >> 8) & 0x0000ff00) ^ \
+	 ((T_FWD ((c) >> 16) << 8) & 0x00ff0000) ^ ((T_FWD ((d) >> 24) << 16) & 0xff000000))
+	store_column (out, FWD_ROUND_LAST (s0, s1, s2, s3) ^ rk[0]) ;
+	store_column (out + 4, FWD_ROUND_LAST (s1, s2, s3, s0) ^ rk[1]) ;
+	store_column (out + 8, FWD_ROUND_LAST (s2, s3, s0, s1) ^ rk[2]) ;
+	store_column (out + 12, FWD_ROUND_LAST (s3, s0, s1, s2) ^ rk[3]) ;
+#undef FWD_ROUND_LAST
+}
+
+static void ttable_decrypt (const uint32_t * rk, int round, const byte * in, byte * out)
+{
+	uint32_t s0 = load_column (in) ^ rk[0] ;
+	uint32_t s1 = load_column (in + 4) ^ rk[1] ;
+	uint32_t s2 = load_column (in + 8) ^ rk[2] ;
+	uint32_t s3 = load_column (in + 12) ^ rk[3] ;
+	uint32_t t0, t1, t2, t3 ;
+	for (int r = 1 ; r < round ; r++) {
+		rk += N_COL ;
+		t0 = T_INV (s0) ^ ROTL8 (T_INV (s3 >> 8)) ^ ROTL16 (T_INV (s2 >> 16)) ^ ROTL24 (T_INV (s1 >> 24)) ^ rk[0] ;
+		t1 = T_INV (s1) ^ ROTL8 (T_INV (s0 >> 8)) ^ ROTL16 (T_INV (s3 >> 16)) ^ ROTL24 (T_INV (s2 >> 24)) ^ rk[1] ;
+		t2 = T_INV (s2) ^ ROTL8 (T_INV (s1 >> 8)) ^ ROTL16 (T_INV (s0 >> 16)) ^ ROTL24 (T_INV (s3 >> 24)) ^ rk[2] ;
+		t3 = T_INV (s3) ^ ROTL8 (T_INV (s2 >> 8)) ^ ROTL16 (T_INV (s1 >> 16)) ^ ROTL24 (T_INV (s0 >> 24)) ^ rk[3] ;
+		s0 = t0 ;
+		s1 = t1 ;
+		s2 = t2 ;
+		s3 = t3 ;
+	}
+	rk += N_COL ;
+	// last round without inverse mix columns
+#define INV_ROUND_LAST(a, b, c, d) \
+	((uint32_t) is_box (a) ^ ((uint32_t) is_box ((b) >> 8) << 8) ^ \
+	 ((uint32_t) is_box ((c) >> 16) << 16) ^ ((uint32_t) is_box ((d) >> 24) << 24))
+	store_column (out, INV_ROUND_LAST (s0, s3, s2, s1) ^ rk[0]) ;
+	store_column (out + 4, INV_ROUND_LAST (s1, s0, s3, s2) ^ rk[1]) ;
+	store_column (out + 8, INV_ROUND_LAST (s2, s1, s0, s3) ^ rk[2]) ;
+	store_column (out + 12, INV_ROUND_LAST (s3, s2, s1, s0) ^ rk[3]) ;
+#undef INV_ROUND_LAST
+}
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+// x86 AES instructions (AES-NI), selected at runtime
+#include <wmmintrin.h>
+#include <cpuid.h>
+#define AES_HW_ACCELERATION
+
+static bool hw_detect (void)
+{
+	unsigned int eax, ebx, ecx, edx ;
+	return __get_cpuid (1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) && (ecx & bit_SSE2) ;
+}
+
+__attribute__((target("aes,sse2")))
+static void hw_encrypt (const uint32_t * rk, int round, const byte * in, byte * out)
+{
+	__m128i s = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) in), _mm_loadu_si128 ((const __m128i *) rk)) ;
+	for (int r = 1 ; r < round ; r++) {
+		s = _mm_aesenc_si128 (s, _mm_loadu_si128 ((const __m128i *) (rk + r * N_COL))) ;
+	}
+	s = _mm_aesenclast_si128 (s, _mm_loadu_si128 ((const __m128i *) (rk + round * N_COL))) ;
+	_mm_storeu_si128 ((__m128i *) out, s) ;
+}
+
+__attribute__((target("aes,sse2")))
+static void hw_decrypt (const uint32_t * rk, int round, const byte * in, byte * out)
+{
+	__m128i s = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) in), _mm_loadu_si128 ((const __m128i *) rk)) ;
+	for (int r = 1 ; r < round ; r++) {
+		s = _mm_aesdec_si128 (s, _mm_loadu_si128 ((const __m128i *) (rk + r * N_COL))) ;
+	}
+	s = _mm_aesdeclast_si128 (s, _mm_loadu_si128 ((const __m128i *) (rk + round * N_COL))) ;
+	_mm_storeu_si128 ((__m128i *) out, s) ;
+}
+#elif defined(__linux__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+// ARMv8 cryptography extensions, requires the crypto extension in the target cpu flags
+// (i.e. -march=armv8-a+crypto or -mfpu=crypto-neon-fp-armv8), selected at runtime
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#define AES_HW_ACCELERATION
+
+static bool hw_detect (void)
+{
+#if defined(__aarch64__)
+	return (getauxval (AT_HWCAP) & (1u << 3)) != 0 ; // HWCAP_AES
+#else
+	return (getauxval (AT_HWCAP2) & (1u << 0)) != 0 ; // HWCAP2_AES
+#endif
+}
+
+static void hw_encrypt (const uint32_t * rk, int round, const byte * in, byte * out)
+{
+	uint8x16_t s = vld1q_u8 (in) ;
+	for (int r = 0 ; r < round - 1 ; r++) {
+		s = vaesmcq_u8 (vaeseq_u8 (s, vld1q_u8 ((const uint8_t *) (rk + r * N_COL)))) ;
+	}
+	s = vaeseq_u8 (s, vld1q_u8 ((const uint8_t *) (rk + (round - 1) * N_COL))) ;
+	vst1q_u8 (out, veorq_u8 (s, vld1q_u8 ((const uint8_t *) (rk + round * N_COL)))) ;
+}
+
+static void hw_decrypt (const uint32_t * rk, int round, const byte * in, byte * out)
+{
+	uint8x16_t s = vld1q_u8 (in) ;
+	for (int r = 0 ; r < round - 1 ; r++) {
+		s = vaesimcq_u8 (vaesdq_u8 (s, vld1q_u8 ((const uint8_t *) (rk + r * N_COL)))) ;
+	}
+	s = vaesdq_u8 (s, vld1q_u8 ((const uint8_t *) (rk + (round - 1) * N_COL))) ;
+	vst1q_u8 (out, veorq_u8 (s, vld1q_u8 ((const uint8_t *) (rk + round * N_COL)))) ;
+}
+#endif
+
+#if defined(AES_HW_ACCELERATION)
+// The AES instructions take the key schedule as bytes in memory, which matches the
+// column words on little endian cpus only
+static bool hw_available (void)
+{
+	static int8_t available = -1 ;
+	if (available < 0) {
+		const uint32_t probe = 1 ;
+		available = (*(const byte *) &probe == 1 && hw_detect ()) ? 1 : 0 ;
+	}
+	return available == 1 ;
+}
+#endif
+
+// Derive the word schedules from the byte schedule, done once per key
+static void ttable_set_key (const byte * key_sched, int round, uint32_t * key_enc, uint32_t * key_dec)
+{
+	const int words = N_COL * (round + 1) ;
+	for (int i = 0 ; i < words ; i++) {
+		key_enc[i] = load_column (key_sched + 4 * i) ;
+	}
+	// equivalent inverse cipher: round keys in reverse order, inner ones inverse mixed
+	for (int r = 0 ; r <= round ; r++) {
+		for (int c = 0 ; c < N_COL ; c++) {
+			const uint32_t w = key_enc[(round - r) * N_COL + c] ;
+			key_dec[r * N_COL + c] = (r == 0 || r == round) ? w : inv_mix_column (w) ;
+		}
+	}
+}
+#endif
 
 /******************************************************************************/
 
@@ -323,6 +590,9 @@ byte AES::set_key (byte key [], int keylen)
 			key_sched [cc + i] = key_sched [tt + i] ^ t[i] ;
 		}
 	}
+#if defined(AES_TTABLE)
+	ttable_set_key (key_sched, round, key_enc, key_dec) ;
+#endif
 	return AES_SUCCESS ;
 }
 
@@ -333,6 +603,10 @@ void AES::clean ()
 	for (byte i = 0 ; i < KEY_SCHEDULE_BYTES ; i++) {
 		key_sched [i] = 0 ;
 	}
+#if defined(AES_TTABLE)
+	memset (key_enc, 0, sizeof (key_enc)) ;
+	memset (key_dec, 0, sizeof (key_dec)) ;
+#endif
 	round = 0 ;
 }
 
@@ -357,6 +631,15 @@ void AES::copy_n_bytes (byte * d, byte * s, byte nn)
 byte AES::encrypt (byte plain [N_BLOCK], byte cipher [N_BLOCK])
 {
 	if (round) {
+#if defined(AES_TTABLE)
+#if defined(AES_HW_ACCELERATION)
+		if (hw_available ()) {
+			hw_encrypt (key_enc, round, plain, cipher) ;
+			return AES_SUCCESS ;
+		}
+#endif
+		ttable_encrypt (key_enc, round, plain, cipher) ;
+#else
 		byte s1 [N_BLOCK], r ;
 		copy_and_key (s1, plain, (byte*) (key_sched)) ;
 
@@ -367,6 +650,7 @@ byte AES::encrypt (byte plain [N_BLOCK], byte cipher [N_BLOCK])
 		}
 		shift_sub_rows (s1) ;
 		copy_and_key (cipher, s1, (byte*) (key_sched + r * N_BLOCK)) ;
+#endif
 	} else {
 		return AES_FAILURE ;
 	}
@@ -410,6 +694,15 @@ byte AES::cbc_encrypt (byte * plain, byte * cipher, int n_block)
 byte AES::decrypt (byte plain [N_BLOCK], byte cipher [N_BLOCK])
 {
 	if (round) {
+#if defined(AES_TTABLE)
+#if defined(AES_HW_ACCELERATION)
+		if (hw_available ()) {
+			hw_decrypt (key_dec, round, plain, cipher) ;
+			return AES_SUCCESS ;
+		}
+#endif
+		ttable_decrypt (key_dec, round, plain, cipher) ;
+#else
 		byte s1 [N_BLOCK] ;
 		copy_and_key (s1, plain, (byte*) (key_sched + round * N_BLOCK)) ;
 		inv_shift_sub_rows (s1) ;
@@ -420,6 +713,7 @@ byte AES::decrypt (byte plain [N_BLOCK], byte cipher [N_BLOCK])
 			inv_mix_sub_columns (s1, s2) ;
 		}
 		copy_and_key (cipher, s1, (byte*) (key_sched)) ;
+#endif
 	} else {
 		return AES_FAILURE ;
 	}
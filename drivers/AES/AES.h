@@ -297,6 +297,10 @@ private:
 	int round ;/**< holds the number of rounds to be used. */
 	byte key_sched [KEY_SCHEDULE_BYTES]
 	;/**< holds the pre-computed key for the encryption/decrpytion. */
+#if defined(AES_TTABLE)
+	uint32_t key_enc [N_COL * (N_MAX_ROUNDS + 1)];/**< encryption key schedule as little endian column words. */
+	uint32_t key_dec [N_COL * (N_MAX_ROUNDS + 1)];/**< decryption key schedule for the equivalent inverse cipher. */
+#endif
 	unsigned long long int IVC;/**< holds the initialization vector counter in numerical format. */
 	byte iv[16];/**< holds the initialization vector that will be used in the cipher. */
 	int pad;/**< holds the size of the padding. */
@@ -26,6 +26,9 @@
 #undef PROGMEM
 #define PROGMEM __attribute__(( section(".progmem.data") ))
 #define pgm_read_byte(p) (*(p))
+#if !defined(pgm_read_dword)
+#define pgm_read_dword(p) (*(p))
+#endif
 typedef unsigned char byte;
 #define printf_P printf
 #define PSTR(x) (x)
@@ -45,4 +48,11 @@ typedef unsigned char byte;
 #define AES_SUCCESS (0)
 #define AES_FAILURE (-1)
 
+/* 32-bit targets use a word oriented engine with lookup tables (2kB) and, on
+   Linux, the AES instructions of the CPU. Define AES_NO_TTABLE to use the byte
+   oriented engine everywhere */
+#if !defined(__AVR__) && !defined(AES_NO_TTABLE)
+#define AES_TTABLE
+#endif
+
 #endif
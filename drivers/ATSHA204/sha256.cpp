@@ -57,6 +57,7 @@ uint32_t Sha256Class::ror32(uint32_t number, uint8_t bits)
 	return ((number << (32-bits)) | (number >> bits));
 }
 
+#if defined(__AVR__)
 void Sha256Class::hashBlock()
 {
 	uint8_t i;
@@ -105,6 +106,197 @@ void Sha256Class::hashBlock()
 	state.w[6] += g;
 	state.w[7] += h;
 }
+#else
+// Unrolled compression for 32-bit targets. Eight rounds are unrolled with the working
+// variables renamed instead of shifted, which removes all register moves between rounds.
+// (AVR keeps the rolled loop above, unrolling there costs several kB of flash.)
+#define SHA256_ROR(x,n) (((x) >> (n)) | ((x) << (32-(n))))
+#define SHA256_CH(x,y,z) ((z) ^ ((x) & ((y) ^ (z))))
+#define SHA256_MAJ(x,y,z) (((x) & (y)) | ((z) & ((x) | (y))))
+#define SHA256_SUM0(x) (SHA256_ROR(x,2) ^ SHA256_ROR(x,13) ^ SHA256_ROR(x,22))
+#define SHA256_SUM1(x) (SHA256_ROR(x,6) ^ SHA256_ROR(x,11) ^ SHA256_ROR(x,25))
+#define SHA256_SIG0(x) (SHA256_ROR(x,7) ^ SHA256_ROR(x,18) ^ ((x) >> 3))
+#define SHA256_SIG1(x) (SHA256_ROR(x,17) ^ SHA256_ROR(x,19) ^ ((x) >> 10))
+// Message schedule, expanded in place in the 16 word buffer
+#define SHA256_W(i) (w[(i)&15] += SHA256_SIG1(w[((i)-2)&15]) + w[((i)-7)&15] + SHA256_SIG0(w[((i)-15)&15]))
+#define SHA256_ROUND(a,b,c,d,e,f,g,h,i,wi) do { \
+		uint32_t t1 = h + SHA256_SUM1(e) + SHA256_CH(e,f,g) + pgm_read_dword(sha256K+(i)) + (wi); \
+		d += t1; \
+		h = t1 + SHA256_SUM0(a) + SHA256_MAJ(a,b,c); \
+	} while (0)
+#define SHA256_ROUNDS8(i,W) do { \
+		SHA256_ROUND(a,b,c,d,e,f,g,h,(i)+0,W((i)+0)); \
+		SHA256_ROUND(h,a,b,c,d,e,f,g,(i)+1,W((i)+1)); \
+		SHA256_ROUND(g,h,a,b,c,d,e,f,(i)+2,W((i)+2)); \
+		SHA256_ROUND(f,g,h,a,b,c,d,e,(i)+3,W((i)+3)); \
+		SHA256_ROUND(e,f,g,h,a,b,c,d,(i)+4,W((i)+4)); \
+		SHA256_ROUND(d,e,f,g,h,a,b,c,(i)+5,W((i)+5)); \
+		SHA256_ROUND(c,d,e,f,g,h,a,b,(i)+6,W((i)+6)); \
+		SHA256_ROUND(b,c,d,e,f,g,h,a,(i)+7,W((i)+7)); \
+	} while (0)
+#define SHA256_W0(i) (w[i])
+
+static void sha256Compress(uint32_t* state, uint32_t* w)
+{
+	uint32_t a = state[0];
+	uint32_t b = state[1];
+	uint32_t c = state[2];
+	uint32_t d = state[3];
+	uint32_t e = state[4];
+	uint32_t f = state[5];
+	uint32_t g = state[6];
+	uint32_t h = state[7];
+
+	SHA256_ROUNDS8(0, SHA256_W0);
+	SHA256_ROUNDS8(8, SHA256_W0);
+	for (uint8_t i = 16; i < 64; i += 8) {
+		SHA256_ROUNDS8(i, SHA256_W);
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+// x86 SHA extensions (SHA-NI), selected at runtime
+#include <immintrin.h>
+#include <cpuid.h>
+#define SHA256_HW_ACCELERATION
+
+static bool sha256HwDetect(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1)) {
+		return false;
+	}
+	if (__get_cpuid_max(0, NULL) < 7) {
+		return false;
+	}
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & (1u << 29)) != 0; // SHA
+}
+
+__attribute__((target("sha,sse4.1")))
+static void sha256HwCompress(uint32_t* state, const uint32_t* w)
+{
+	__m128i msg, tmp, m[4];
+	// Load state as ABEF/CDGH, the layout used by the SHA instructions
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+	const __m128i abefSave = state0;
+	const __m128i cdghSave = state1;
+
+	for (uint8_t i = 0; i < 16; i++) {
+		if (i < 4) {
+			m[i] = _mm_loadu_si128((const __m128i*)&w[i * 4]);
+		}
+		msg = _mm_add_epi32(m[i & 3], _mm_loadu_si128((const __m128i*)&sha256K[i * 4]));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		if (i >= 3 && i <= 14) {
+			tmp = _mm_alignr_epi8(m[i & 3], m[(i - 1) & 3], 4);
+			m[(i + 1) & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(m[(i + 1) & 3], tmp), m[i & 3]);
+		}
+		msg = _mm_shuffle_epi32(msg, 0x0E);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		if (i >= 1 && i <= 12) {
+			m[(i - 1) & 3] = _mm_sha256msg1_epu32(m[(i - 1) & 3], m[i & 3]);
+		}
+	}
+
+	state0 = _mm_add_epi32(state0, abefSave);
+	state1 = _mm_add_epi32(state1, cdghSave);
+	// Back to ABCD/EFGH
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	_mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+	_mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+#elif defined(__linux__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+// ARMv8 cryptography extensions, requires the crypto extension in the target cpu flags
+// (i.e. -march=armv8-a+crypto or -mfpu=crypto-neon-fp-armv8), selected at runtime
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#define SHA256_HW_ACCELERATION
+
+static bool sha256HwDetect(void)
+{
+#if defined(__aarch64__)
+	return (getauxval(AT_HWCAP) & (1u << 6)) != 0; // HWCAP_SHA2
+#else
+	return (getauxval(AT_HWCAP2) & (1u << 3)) != 0; // HWCAP2_SHA2
+#endif
+}
+
+static void sha256HwCompress(uint32_t* state, const uint32_t* w)
+{
+	uint32x4_t state0 = vld1q_u32(&state[0]);
+	uint32x4_t state1 = vld1q_u32(&state[4]);
+	const uint32x4_t abcdSave = state0;
+	const uint32x4_t efghSave = state1;
+	uint32x4_t m[4];
+	for (uint8_t i = 0; i < 4; i++) {
+		m[i] = vld1q_u32(&w[i * 4]);
+	}
+
+	for (uint8_t i = 0; i < 16; i++) {
+		const uint32x4_t wk = vaddq_u32(m[i & 3], vld1q_u32(&sha256K[i * 4]));
+		if (i < 12) {
+			m[i & 3] = vsha256su1q_u32(vsha256su0q_u32(m[i & 3], m[(i + 1) & 3]), m[(i + 2) & 3],
+			                           m[(i + 3) & 3]);
+		}
+		const uint32x4_t tmp = state0;
+		state0 = vsha256hq_u32(state0, state1, wk);
+		state1 = vsha256h2q_u32(state1, tmp, wk);
+	}
+
+	vst1q_u32(&state[0], vaddq_u32(state0, abcdSave));
+	vst1q_u32(&state[4], vaddq_u32(state1, efghSave));
+}
+#endif
+
+#if defined(SHA256_HW_ACCELERATION)
+static bool sha256HwAvailable(void)
+{
+	static int8_t available = -1;
+	if (available < 0) {
+		available = sha256HwDetect() ? 1 : 0;
+	}
+	return available == 1;
+}
+#endif
+
+void Sha256Class::hashBlock()
+{
+#if defined(SHA256_HW_ACCELERATION)
+	if (sha256HwAvailable()) {
+		sha256HwCompress(state.w, buffer.w);
+		return;
+	}
+#endif
+	sha256Compress(state.w, buffer.w);
+}
+#endif
+
+void Sha256Class::hashBlocks(const uint8_t* data, size_t blocks)
+{
+	while (blocks--) {
+		// Load the block as big endian words
+		for (uint8_t i = 0; i < BLOCK_LENGTH / 4; i++) {
+			buffer.w[i] = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+			              ((uint32_t)data[2] << 8) | data[3];
+			data += 4;
+		}
+		hashBlock();
+	}
+}
 
 void Sha256Class::addUncounted(uint8_t data)
 {
@@ -122,25 +314,48 @@ void Sha256Class::write(uint8_t data)
 	addUncounted(data);
 }
 
+void Sha256Class::write(const uint8_t* data, size_t length)
+{
+	byteCount += length;
+	// Complete a partially filled block first
+	while (bufferOffset != 0 && length > 0) {
+		addUncounted(*data++);
+		length--;
+	}
+	// Compress whole blocks directly from the input
+	const size_t blocks = length / BLOCK_LENGTH;
+	if (blocks > 0) {
+		hashBlocks(data, blocks);
+		data += blocks * BLOCK_LENGTH;
+		length -= blocks * BLOCK_LENGTH;
+	}
+	// Buffer the remainder, it is less than a block
+	while (length--) {
+		buffer.b[bufferOffset++ ^ 3] = *data++;
+	}
+}
+
 void Sha256Class::pad()
 {
 	// Implement SHA-256 padding (fips180-2 §5.1.1)
 
 	// Pad with 0x80 followed by 0x00 until the end of the block
 	addUncounted(0x80);
-	while (bufferOffset != 56) {
-		addUncounted(0x00);
+	while (bufferOffset & 3) {
+		buffer.b[bufferOffset++ ^ 3] = 0x00;
+	}
+	if (bufferOffset > 56) {
+		memset(&buffer.b[bufferOffset], 0, BLOCK_LENGTH - bufferOffset);
+		hashBlock();
+		bufferOffset = 0;
 	}
+	memset(&buffer.b[bufferOffset], 0, 56 - bufferOffset);
 
-	// Append length in the last 8 bytes
-	addUncounted(0); // We're only using 32 bit lengths
-	addUncounted(0); // But SHA-1 supports 64 bit lengths
-	addUncounted(0); // So zero pad the top bits
-	addUncounted(byteCount >> 29); // Shifting to multiply by 8
-	addUncounted(byteCount >> 21); // as SHA-1 supports bitstreams as well as
-	addUncounted(byteCount >> 13); // byte.
-	addUncounted(byteCount >> 5);
-	addUncounted(byteCount << 3);
+	// Append length in the last 8 bytes (buffer holds words in host order)
+	buffer.w[14] = byteCount >> 29; // We're only using 32 bit lengths
+	buffer.w[15] = byteCount << 3;  // Shifting to multiply by 8
+	hashBlock();
+	bufferOffset = 0;
 }
 
 
@@ -167,43 +382,55 @@ uint8_t* Sha256Class::result(void)
 #define HMAC_IPAD 0x36
 #define HMAC_OPAD 0x5c
 
-uint8_t keyBuffer[BLOCK_LENGTH]; // K0 in FIPS-198a
-uint8_t innerHash[HASH_LENGTH];
-
 void Sha256Class::initHmac(const uint8_t* key, int keyLength)
 {
+	uint8_t keyBuffer[BLOCK_LENGTH]; // K0 in FIPS-198a
 	uint8_t i;
 	memset(keyBuffer,0,BLOCK_LENGTH);
 	if (keyLength > BLOCK_LENGTH) {
 		// Hash long keys
 		init();
-		for (; keyLength--;) {
-			write(*key++);
-		}
+		write(key, keyLength);
 		memcpy(keyBuffer,result(),HASH_LENGTH);
 	} else {
 		// Block length keys are used as is
 		memcpy(keyBuffer,key,keyLength);
 	}
-	// Start inner hash
+	// The ipad and opad blocks only depend on the key, keep the state after each of them
+	// so that every HMAC with this key can start from there
+	for (i=0; i<BLOCK_LENGTH; i++) {
+		keyBuffer[i] ^= HMAC_OPAD;
+	}
 	init();
+	write(keyBuffer, BLOCK_LENGTH);
+	outerState = state;
 	for (i=0; i<BLOCK_LENGTH; i++) {
-		write(keyBuffer[i] ^ HMAC_IPAD);
+		keyBuffer[i] ^= HMAC_OPAD ^ HMAC_IPAD;
 	}
+	init();
+	write(keyBuffer, BLOCK_LENGTH);
+	innerState = state;
+	memset(keyBuffer,0,BLOCK_LENGTH);
+	// Start inner hash
+	resumeHmac();
+}
+
+void Sha256Class::resumeHmac(void)
+{
+	state = innerState;
+	byteCount = BLOCK_LENGTH;
+	bufferOffset = 0;
 }
 
 uint8_t* Sha256Class::resultHmac(void)
 {
-	uint8_t i;
+	uint8_t innerHash[HASH_LENGTH];
 	// Complete inner hash
 	memcpy(innerHash,result(),HASH_LENGTH);
 	// Calculate outer hash
-	init();
-	for (i=0; i<BLOCK_LENGTH; i++) {
-		write(keyBuffer[i] ^ HMAC_OPAD);
-	}
-	for (i=0; i<HASH_LENGTH; i++) {
-		write(innerHash[i]);
-	}
+	state = outerState;
+	byteCount = BLOCK_LENGTH;
+	bufferOffset = 0;
+	write(innerHash, HASH_LENGTH);
 	return result();
 }
@@ -3,6 +3,7 @@
 #define Sha256_h
 #if !DOXYGEN
 #include <inttypes.h>
+#include <stddef.h>
 
 #define HASH_LENGTH 32
 #define BLOCK_LENGTH 64
@@ -22,20 +23,23 @@ public:
 	Sha256Class(); // Constructor
 	void init(void);
 	void initHmac(const uint8_t* secret, int secretLength);
+	void resumeHmac(void); // Start a new HMAC with the key of the last initHmac()
 	uint8_t* result(void);
 	uint8_t* resultHmac(void);
 	void write(uint8_t);
+	void write(const uint8_t* data, size_t length); // Whole blocks are compressed straight from data
 private:
 	void pad();
 	void addUncounted(uint8_t data);
 	void hashBlock();
+	void hashBlocks(const uint8_t* data, size_t blocks);
 	uint32_t ror32(uint32_t number, uint8_t bits);
 	_buffer buffer;
 	uint8_t bufferOffset;
 	_state state;
 	uint32_t byteCount;
-	uint8_t keyBuffer[BLOCK_LENGTH];
-	uint8_t innerHash[HASH_LENGTH];
+	_state innerState; // State after the ipad block of the HMAC key
+	_state outerState; // State after the opad block of the HMAC key
 };
 
 #endif
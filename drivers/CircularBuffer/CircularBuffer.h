@@ -27,33 +27,49 @@
 #ifndef CircularBuffer_h
 #define CircularBuffer_h
 
+#include <stddef.h>
+
 /**
  * The circular buffer class.
- * Pass the datatype to be stored in the buffer as template parameter.
+ * Pass the datatype to be stored in the buffer and the number of records as template
+ * parameters. The number of records must be a power of two.
+ *
+ * The buffer is safe without locking for a single producer (e.g. an interrupt handler),
+ * using the front of the buffer, and a single consumer, using the back of the buffer.
+ * Both free-running indices are published with release stores and read with acquire loads.
+ * On AVR, where the indices are not read or written in one instruction, the accesses
+ * to the index of the other side take a critical section.
  */
-template <class T> class CircularBuffer
+template <class T, size_t N> class CircularBuffer
 {
+	static_assert(N > 0 && (N & (N - 1)) == 0, "CircularBuffer size must be a power of two");
+
 public:
 	/**
 	 * Constructor
-	 * @param buffer   Preallocated buffer of at least size records.
-	 * @param size     Number of records available in the buffer.
 	 */
-	CircularBuffer(T* buffer, const uint8_t size )
-		: m_size(size), m_buff(buffer)
+	CircularBuffer()
 	{
 		clear();
 	}
 
 	/**
 	  * Clear all entries in the circular buffer.
+	  * Must not be called while a producer or consumer is using the buffer.
 	  */
 	void clear(void)
 	{
-		MY_CRITICAL_SECTION {
-			m_front = 0;
-			m_fill  = 0;
-		}
+		store(&m_front, 0);
+		store(&m_back, 0);
+	}
+
+	/**
+	 * Number of records that can be stored in the buffer.
+	 * @return Number of records.
+	 */
+	static inline size_t capacity(void)
+	{
+		return N;
 	}
 
 	/**
@@ -62,11 +78,7 @@ public:
 	 */
 	inline bool empty(void) const
 	{
-		bool empty;
-		MY_CRITICAL_SECTION {
-			empty = !m_fill;
-		}
-		return empty;
+		return available() == 0;
 	}
 
 	/**
@@ -75,121 +87,184 @@ public:
 	 */
 	inline bool full(void) const
 	{
-		bool full;
-		MY_CRITICAL_SECTION {
-			full = m_fill == m_size;
-		}
-		return full;
+		return available() == N;
 	}
 
 	/**
 	 * Return the number of records stored in the buffer.
 	 * @return number of records.
 	 */
-	inline uint8_t available(void) const
+	inline size_t available(void) const
 	{
-		MY_CRITICAL_SECTION {
-			return m_fill;
-		}
+		return load(&m_front) - load(&m_back);
 	}
 
 	/**
-	 * Aquire unused record on front of the buffer, for writing.
+	 * Aquire unused record on front of the buffer, for writing. Producer only.
 	 * After filling the record, it has to be pushed to actually
 	 * add it to the buffer.
 	 * @return Pointer to record, or NULL when buffer is full.
 	 */
-	T* getFront(void) const
+	T* getFront(void)
 	{
-		MY_CRITICAL_SECTION {
-			if (!full())
-			{
-				return get(m_front);
-			}
+		const size_t front = m_front;
+		if (front - load(&m_back) == N) {
+			return static_cast<T*>(NULL);
 		}
-		return static_cast<T*>(NULL);
+		return get(front);
 	}
 
 	/**
-	 * Push record to front of the buffer.
+	 * Push record to front of the buffer. Producer only.
 	 * @param record   Record to push. If record was aquired previously (using getFront) its
 	 *                 data will not be copied as it is already present in the buffer.
 	 * @return True, when record was pushed successfully.
 	 */
 	bool pushFront(T* record)
 	{
-		MY_CRITICAL_SECTION {
-			if (!full())
-			{
-				T* f = get(m_front);
-				if (f != record) {
-					*f = *record;
-				}
-				m_front = (m_front+1) % m_size;
-				m_fill++;
-				return true;
-			}
+		const size_t front = m_front;
+		if (front - load(&m_back) == N) {
+			return false;
+		}
+		T* f = get(front);
+		if (f != record) {
+			*f = *record;
+		}
+		store(&m_front, front + 1);
+		return true;
+	}
+
+	/**
+	 * Push records to front of the buffer, as many as there is room for. Producer only.
+	 * @param records  Records to push, copied.
+	 * @param count    Number of records.
+	 * @return Number of records pushed.
+	 */
+	size_t pushFront(const T* records, size_t count)
+	{
+		const size_t front = m_front;
+		const size_t room = N - (front - load(&m_back));
+		if (count > room) {
+			count = room;
+		}
+		for (size_t i = 0; i < count; i++) {
+			*get(front + i) = records[i];
 		}
-		return false;
+		store(&m_front, front + count);
+		return count;
 	}
 
 	/**
-	 * Aquire record on back of the buffer, for reading.
+	 * Aquire record on back of the buffer, for reading. Consumer only.
 	 * After reading the record, it has to be pop'ed to actually
 	 * remove it from the buffer.
 	 * @return Pointer to record, or NULL when buffer is empty.
 	 */
-	T* getBack(void) const
+	T* getBack(void)
 	{
-		MY_CRITICAL_SECTION {
-			if (!empty())
-			{
-				return get(back());
-			}
+		const size_t back = m_back;
+		if (load(&m_front) == back) {
+			return static_cast<T*>(NULL);
+		}
+		return get(back);
+	}
+
+	/**
+	 * Aquire a record behind the back of the buffer, for reading. Consumer only.
+	 * @param offset   Number of records between the back and the record.
+	 * @return Pointer to record, or NULL when less records are stored.
+	 */
+	T* getBack(const size_t offset)
+	{
+		const size_t back = m_back;
+		if (load(&m_front) - back <= offset) {
+			return static_cast<T*>(NULL);
 		}
-		return static_cast<T*>(NULL);
+		return get(back + offset);
 	}
 
 	/**
-	 * Remove record from back of the buffer.
+	 * Remove record from back of the buffer. Consumer only.
 	 * @return True, when record was pop'ed successfully.
 	 */
 	bool popBack(void)
 	{
-		MY_CRITICAL_SECTION {
-			if (!empty())
-			{
-				m_fill--;
-				return true;
-			}
+		const size_t back = m_back;
+		if (load(&m_front) == back) {
+			return false;
+		}
+		store(&m_back, back + 1);
+		return true;
+	}
+
+	/**
+	 * Remove records from back of the buffer, as many as are stored. Consumer only.
+	 * @param records  Buffer for the records removed, of at least count records.
+	 * @param count    Number of records.
+	 * @return Number of records pop'ed.
+	 */
+	size_t popBack(T* records, size_t count)
+	{
+		const size_t back = m_back;
+		const size_t fill = load(&m_front) - back;
+		if (count > fill) {
+			count = fill;
+		}
+		for (size_t i = 0; i < count; i++) {
+			records[i] = *get(back + i);
 		}
-		return false;
+		store(&m_back, back + count);
+		return count;
 	}
 
 protected:
 	/**
 	 * Internal getter for records.
-	 * @param idx   Record index in buffer.
+	 * @param idx   Free-running record index.
 	 * @return Ptr to record.
 	 */
-	inline T * get(const uint8_t idx) const
+	inline T * get(const size_t idx)
+	{
+		return &m_buff[idx & (N - 1)];
+	}
+
+	/**
+	 * Read an index written by the other side.
+	 * @param idx   Index to read.
+	 * @return Index value, records up to it are visible.
+	 */
+	static inline size_t load(const size_t* idx)
 	{
-		return &(m_buff[idx]);
+#if defined(__AVR__)
+		size_t value;
+		MY_CRITICAL_SECTION {
+			value = *(const volatile size_t*)idx;
+		}
+		return value;
+#else
+		return __atomic_load_n(idx, __ATOMIC_ACQUIRE);
+#endif
 	}
 
 	/**
-	 * Internal getter for index of last used record in buffer.
-	 * @return Index of last record.
+	 * Publish an index to the other side.
+	 * @param idx   Index to write.
+	 * @param value Index value, records up to it have been written or read.
 	 */
-	inline uint8_t back(void) const
+	static inline void store(size_t* idx, const size_t value)
 	{
-		return (m_front - m_fill + m_size) % m_size;
+#if defined(__AVR__)
+		MY_CRITICAL_SECTION {
+			*(volatile size_t*)idx = value;
+		}
+#else
+		__atomic_store_n(idx, value, __ATOMIC_RELEASE);
+#endif
 	}
 
-	const uint8_t      m_size;     //!< Total number of records that can be stored in the buffer.
-	T* const           m_buff;     //!< Ptr to buffer holding all records.
-	volatile uint8_t   m_front;    //!< Index of front element (not pushed yet).
-	volatile uint8_t   m_fill;     //!< Amount of records currently pushed.
+	T                  m_buff[N];  //!< Buffer holding all records.
+	size_t             m_front;    //!< Free-running index of front element (not pushed yet), written by the producer.
+	size_t             m_back;     //!< Free-running index of back element, written by the consumer.
 };
 
 #endif // CircularBuffer_h
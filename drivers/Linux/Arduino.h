@@ -18,6 +18,11 @@
 using namespace rpi_util;
 #endif
 
+#ifdef LINUX_ARCH_GENERIC
+#include "gpio_util.h"
+using namespace gpio_util;
+#endif
+
 #undef PSTR
 #define PSTR(x) (x)
 #undef F
@@ -60,6 +65,10 @@ using namespace rpi_util;
 #define delay _delay_ms
 #endif
 
+#ifndef delayMicroseconds
+#define delayMicroseconds _delay_us
+#endif
+
 using std::string;
 using std::min;
 using std::max;
@@ -74,6 +83,7 @@ void yield(void);
 unsigned long millis(void);
 unsigned long micros(void);
 void _delay_ms(unsigned int millis);
+void _delay_us(unsigned int micros);
 void randomSeed(unsigned long seed);
 long randMax(long howbig);
 long randMinMax(long howsmall, long howbig);
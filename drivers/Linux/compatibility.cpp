@@ -1,5 +1,10 @@
+#include <errno.h>
+#include <stdio.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <sys/types.h>
 #include <stdlib.h>
 #include "Arduino.h"
 
@@ -43,6 +48,15 @@ void _delay_ms(unsigned int millis)
 	nanosleep(&sleeper, NULL);
 }
 
+void _delay_us(unsigned int micros)
+{
+	struct timespec sleeper;
+
+	sleeper.tv_sec  = (time_t)(micros / 1000000);
+	sleeper.tv_nsec = (long)(micros % 1000000) * 1000;
+	nanosleep(&sleeper, NULL);
+}
+
 void randomSeed(unsigned long seed)
 {
 	if (seed != 0) {
@@ -66,3 +80,23 @@ long randMinMax(long howsmall, long howbig)
 	long diff = howbig - howsmall;
 	return randMax(diff) + howsmall;
 }
+
+// Shared by the Linux hardware layers (MyHwLinuxGeneric.h)
+ssize_t hwGetentropy(void* buffer, size_t length)
+{
+#if defined(SYS_getrandom)
+	// Requests of up to 256 bytes are never interrupted once the kernel pool is initialized
+	const long ret = syscall(SYS_getrandom, buffer, length, 0);
+	if (ret >= 0 || errno != ENOSYS) {
+		return ret;
+	}
+#endif
+	// Kernels older than 3.17 have no getrandom()
+	FILE* urandom = fopen("/dev/urandom", "rb");
+	if (urandom == NULL) {
+		return -1;
+	}
+	const size_t count = fread(buffer, 1, length, urandom);
+	fclose(urandom);
+	return count;
+}
@@ -0,0 +1,195 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include "interrupt.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/gpio.h>
+#include "log.h"
+
+#define INTERRUPT_PINS		(256)
+#define INTERRUPT_WAKE		(INTERRUPT_PINS)	// epoll tag of the wakeup eventfd
+#define INTERRUPT_EVENTS	(16)
+#define INTERRUPT_PRIORITY	(55)
+
+typedef void (*interruptHandler_t)();
+
+static interruptHandler_t handlers[INTERRUPT_PINS] = {NULL};
+static int lineFds[INTERRUPT_PINS];
+static bool enabled = true;
+// lines with an event while interrupts were disabled, and the time of the event
+static uint32_t pending[INTERRUPT_PINS / 32] = {0};
+static uint64_t pendingTimestamps[INTERRUPT_PINS];
+// time of the edge being handled, dispatcher thread only
+static uint64_t timestamp = 0;
+
+static int epollFd = -1;
+static int wakeFd = -1;
+static pthread_once_t started = PTHREAD_ONCE_INIT;
+
+static void deliver(uint8_t pin, uint64_t time)
+{
+	const interruptHandler_t func = __atomic_load_n(&handlers[pin], __ATOMIC_ACQUIRE);
+	if (func == NULL) {
+		return;
+	}
+	if (!__atomic_load_n(&enabled, __ATOMIC_ACQUIRE)) {
+		pendingTimestamps[pin] = time;
+		__atomic_fetch_or(&pending[pin >> 5], 1u << (pin & 31), __ATOMIC_RELEASE);
+		return;
+	}
+	timestamp = time;
+	func();
+}
+
+static void deliverPending()
+{
+	for (int word = 0; word < INTERRUPT_PINS / 32; word++) {
+		uint32_t bits = __atomic_exchange_n(&pending[word], 0, __ATOMIC_ACQ_REL);
+		while (bits) {
+			const int bit = __builtin_ctz(bits);
+			bits &= bits - 1;
+			const uint8_t pin = word * 32 + bit;
+			deliver(pin, pendingTimestamps[pin]);
+		}
+	}
+}
+
+static void *dispatcher(void *args)
+{
+	(void)args;
+	struct epoll_event ready[INTERRUPT_EVENTS];
+	struct gpio_v2_line_event events[INTERRUPT_EVENTS];
+
+	// Only effective if we run as root
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = INTERRUPT_PRIORITY;
+	(void)pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+	while (1) {
+		const int count = epoll_wait(epollFd, ready, INTERRUPT_EVENTS, -1);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			logError("Error waiting for interrupt: %s\n", strerror(errno));
+			break;
+		}
+		for (int i = 0; i < count; i++) {
+			const uint32_t tag = ready[i].data.u32;
+			if (tag == INTERRUPT_WAKE) {
+				uint64_t value;
+				(void)read(wakeFd, &value, sizeof(value));
+				continue;
+			}
+			const int fd = __atomic_load_n(&lineFds[tag], __ATOMIC_ACQUIRE);
+			if (fd == -1) {
+				continue;
+			}
+			// the kernel queues the events per line, with their time
+			const ssize_t len = read(fd, events, sizeof(events));
+			for (ssize_t j = 0; j < len / (ssize_t)sizeof(events[0]); j++) {
+				deliver(tag, events[j].timestamp_ns);
+			}
+		}
+		if (__atomic_load_n(&enabled, __ATOMIC_ACQUIRE)) {
+			deliverPending();
+		}
+	}
+
+	return NULL;
+}
+
+static void start()
+{
+	for (int i = 0; i < INTERRUPT_PINS; i++) {
+		lineFds[i] = -1;
+	}
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (epollFd < 0 || wakeFd < 0) {
+		logError("Unable to set up interrupts: %s\n", strerror(errno));
+		exit(1);
+	}
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u32 = INTERRUPT_WAKE;
+	(void)epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, dispatcher, NULL)) {
+		logError("Unable to start the interrupt thread\n");
+		exit(1);
+	}
+	pthread_detach(thread);
+}
+
+void interruptAttach(uint8_t pin, int fd, void (*func)())
+{
+	pthread_once(&started, start);
+
+	if (lineFds[pin] != -1) {
+		(void)epoll_ctl(epollFd, EPOLL_CTL_DEL, lineFds[pin], NULL);
+	}
+	__atomic_store_n(&handlers[pin], func, __ATOMIC_RELEASE);
+	__atomic_store_n(&lineFds[pin], fd, __ATOMIC_RELEASE);
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u32 = pin;
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+		logError("Unable to attach interrupt for pin %d: %s\n", pin, strerror(errno));
+	}
+}
+
+void interruptDetach(uint8_t pin)
+{
+	pthread_once(&started, start);
+
+	if (lineFds[pin] != -1) {
+		(void)epoll_ctl(epollFd, EPOLL_CTL_DEL, lineFds[pin], NULL);
+	}
+	__atomic_store_n(&lineFds[pin], -1, __ATOMIC_RELEASE);
+	__atomic_store_n(&handlers[pin], (interruptHandler_t)NULL, __ATOMIC_RELEASE);
+	__atomic_fetch_and(&pending[pin >> 5], ~(1u << (pin & 31)), __ATOMIC_RELEASE);
+}
+
+void interruptEnable(bool enable)
+{
+	__atomic_store_n(&enabled, enable, __ATOMIC_RELEASE);
+	if (enable && wakeFd != -1) {
+		// the dispatcher delivers the events that arrived meanwhile
+		const uint64_t value = 1;
+		(void)write(wakeFd, &value, sizeof(value));
+	}
+}
+
+uint64_t interruptTimestamp(void)
+{
+	return timestamp;
+}
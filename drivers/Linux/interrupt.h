@@ -0,0 +1,65 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#ifndef interrupt_h
+#define interrupt_h
+
+#include <stdint.h>
+
+/**
+ * Interrupts from GPIO lines requested with edge detection from the GPIO character device.
+ *
+ * One dispatcher thread waits on all lines with epoll, reads the edge events and calls the
+ * handler of the line, in the order of the events. Handlers are installed and interrupts
+ * enabled with atomic stores, the dispatcher takes no lock. Events arriving while interrupts
+ * are disabled are delivered when they are enabled again, once per line.
+ */
+
+/**
+ * @brief Call a handler for the edge events of a line.
+ *
+ * @param pin Pin number, identifies the line.
+ * @param fd Line request with edge detection, owned by the caller.
+ * @param func Handler, called from the dispatcher thread.
+ */
+void interruptAttach(uint8_t pin, int fd, void (*func)());
+
+/**
+ * @brief Stop calling the handler of a line, the line request can be closed afterwards.
+ *
+ * @param pin Pin number.
+ */
+void interruptDetach(uint8_t pin);
+
+/**
+ * @brief Enable or disable the delivery of interrupts.
+ *
+ * @param enable true to enable.
+ */
+void interruptEnable(bool enable);
+
+/**
+ * @brief Kernel timestamp of the edge being handled, for latency accounting.
+ *
+ * Valid in a handler only.
+ * @return CLOCK_MONOTONIC time of the edge in ns.
+ */
+uint64_t interruptTimestamp(void);
+
+#endif
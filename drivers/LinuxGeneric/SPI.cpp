@@ -0,0 +1,220 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include "SPI.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "log.h"
+
+// recursive, a driver may hold one transaction over a sequence of transfers
+static pthread_mutex_t spiMutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+// Declare a single default instance
+SPIClass SPI = SPIClass();
+
+uint8_t SPIClass::initialized = 0;
+const char *SPIClass::device = "/dev/spidev0.0";
+int SPIClass::fd = -1;
+uint32_t SPIClass::speed = 8000000;
+uint8_t SPIClass::mode = SPI_MODE0;
+uint8_t SPIClass::depth = 0;
+struct spi_ioc_transfer SPIClass::queue[SPI_QUEUE_TRANSFERS];
+uint8_t SPIClass::queued = 0;
+uint8_t SPIClass::queueData[SPI_QUEUE_SIZE];
+uint16_t SPIClass::queueUsed = 0;
+
+uint8_t SPIClass::is_initialized()
+{
+	return initialized;
+}
+
+void SPIClass::setDevice(const char* spidev)
+{
+	device = spidev;
+}
+
+void SPIClass::begin()
+{
+	if (!initialized) {
+		if ((fd = open(device, O_RDWR | O_CLOEXEC)) < 0) {
+			logError("Unable to open SPI device %s: %s\n", device, strerror(errno));
+			exit(1);
+		}
+		if (ioctl(fd, SPI_IOC_WR_MODE, &mode) < 0) {
+			logError("Unable to set SPI mode: %s\n", strerror(errno));
+		}
+	}
+
+	initialized++; // reference count
+}
+
+void SPIClass::end()
+{
+	if (initialized) {
+		initialized--;
+	}
+
+	if (!initialized && fd >= 0) {
+		// End the SPI
+		close(fd);
+		fd = -1;
+	}
+}
+
+void SPIClass::setMode(uint8_t newMode)
+{
+	if (newMode == mode) {
+		return;
+	}
+	// queued transfers go out with the mode they were queued with
+	flush();
+	mode = newMode;
+	if (fd >= 0 && ioctl(fd, SPI_IOC_WR_MODE, &mode) < 0) {
+		logError("Unable to set SPI mode: %s\n", strerror(errno));
+	}
+}
+
+void SPIClass::setBitOrder(uint8_t bit_order)
+{
+	setMode((mode & ~SPI_LSB_FIRST) | (bit_order == gpio_util::LSBFIRST ? SPI_LSB_FIRST : 0));
+}
+
+void SPIClass::setDataMode(uint8_t data_mode)
+{
+	setMode((mode & SPI_LSB_FIRST) | (data_mode & (SPI_CPHA | SPI_CPOL)));
+}
+
+void SPIClass::setClockDivider(uint16_t divider)
+{
+	speed = SPI_CLOCK_BASE / divider;
+}
+
+void SPIClass::chipSelect(int csn_pin)
+{
+	(void)csn_pin;
+}
+
+void SPIClass::flush(char* tbuf, char* rbuf, uint32_t len)
+{
+	uint8_t count = queued;
+	if (tbuf != NULL) {
+		struct spi_ioc_transfer *xfer = &queue[count++];
+		memset(xfer, 0, sizeof(*xfer));
+		xfer->tx_buf = (unsigned long)tbuf;
+		xfer->rx_buf = (unsigned long)rbuf;
+		xfer->len = len;
+		xfer->speed_hz = speed;
+		xfer->bits_per_word = 8;
+	}
+	if (!count) {
+		return;
+	}
+	// the chip is deselected between the transfers of the message, as between separate ones
+	for (uint8_t i = 0; i < count - 1; i++) {
+		queue[i].cs_change = 1;
+	}
+	queue[count - 1].cs_change = 0;
+	if (ioctl(fd, SPI_IOC_MESSAGE(count), queue) < 0) {
+		logError("SPI transfer failed: %s\n", strerror(errno));
+	}
+	queued = 0;
+	queueUsed = 0;
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+	char tbuf = data;
+	char rbuf = 0;
+	transfernb(&tbuf, &rbuf, 1);
+	return rbuf;
+}
+
+void SPIClass::transfernb(char* tbuf, char* rbuf, uint32_t len)
+{
+	pthread_mutex_lock(&spiMutex);
+	flush(tbuf, rbuf, len);
+	pthread_mutex_unlock(&spiMutex);
+}
+
+void SPIClass::transfern(char* buf, uint32_t len)
+{
+	transfernb(buf, buf, len);
+}
+
+void SPIClass::transferQueued(const char* tbuf, uint32_t len)
+{
+	pthread_mutex_lock(&spiMutex);
+	if (!depth || len > SPI_QUEUE_SIZE) {
+		// nothing sends the queue later
+		flush((char*)tbuf, NULL, len);
+	} else {
+		// keep a transfer free for the one sending the queue
+		if (queued == SPI_QUEUE_TRANSFERS - 1 || queueUsed + len > SPI_QUEUE_SIZE) {
+			flush();
+		}
+		struct spi_ioc_transfer *xfer = &queue[queued++];
+		memset(xfer, 0, sizeof(*xfer));
+		memcpy(&queueData[queueUsed], tbuf, len);
+		xfer->tx_buf = (unsigned long)&queueData[queueUsed];
+		xfer->len = len;
+		xfer->speed_hz = speed;
+		xfer->bits_per_word = 8;
+		queueUsed += len;
+	}
+	pthread_mutex_unlock(&spiMutex);
+}
+
+void SPIClass::flushQueued()
+{
+	pthread_mutex_lock(&spiMutex);
+	flush();
+	pthread_mutex_unlock(&spiMutex);
+}
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+	pthread_mutex_lock(&spiMutex);
+	depth++;
+	setMode((settings.border == gpio_util::LSBFIRST ? SPI_LSB_FIRST : 0) |
+	        (settings.dmode & (SPI_CPHA | SPI_CPOL)));
+	speed = settings.clock;
+}
+
+void SPIClass::endTransaction()
+{
+	if (!--depth) {
+		flush();
+	}
+	pthread_mutex_unlock(&spiMutex);
+}
+
+void SPIClass::usingInterrupt(uint8_t interruptNumber)
+{
+	(void)interruptNumber;
+}
+
+void SPIClass::notUsingInterrupt(uint8_t interruptNumber)
+{
+	(void)interruptNumber;
+}
@@ -0,0 +1,242 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#ifndef _SPI_H_
+#define _SPI_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <linux/spi/spidev.h>
+#include "gpio_util.h"
+
+#define SPI_HAS_TRANSACTION
+
+// SPI Clock divider, of a 16MHz clock
+#define SPI_CLOCK_BASE 16000000ul
+#define SPI_CLOCK_DIV2 2
+#define SPI_CLOCK_DIV4 4
+#define SPI_CLOCK_DIV8 8
+#define SPI_CLOCK_DIV16 16
+#define SPI_CLOCK_DIV32 32
+#define SPI_CLOCK_DIV64 64
+#define SPI_CLOCK_DIV128 128
+
+// SPI Data mode
+#define SPI_MODE0 SPI_MODE_0
+#define SPI_MODE1 SPI_MODE_1
+#define SPI_MODE2 SPI_MODE_2
+#define SPI_MODE3 SPI_MODE_3
+
+// Queued writes, sent with the next transfer in one SPI_IOC_MESSAGE
+#define SPI_QUEUE_TRANSFERS 16
+#define SPI_QUEUE_SIZE 256
+
+/**
+ * SPISettings class
+ */
+class SPISettings
+{
+
+public:
+	/**
+	 * @brief SPISettings constructor.
+	 *
+	 * Default clock speed is 8Mhz.
+	 */
+	SPISettings()
+	{
+		init(8000000, gpio_util::MSBFIRST, SPI_MODE0);
+	}
+	/**
+	 * @brief SPISettings constructor.
+	 *
+	 * @param clock SPI clock speed in Hz.
+	 * @param bitOrder SPI bit order.
+	 * @param dataMode SPI data mode.
+	 */
+	SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+	{
+		init(clock, bitOrder, dataMode);
+	}
+
+	uint32_t clock; //!< @brief SPI clock speed in Hz.
+	uint8_t border; //!< @brief SPI bit order.
+	uint8_t dmode; //!< @brief SPI data mode.
+
+private:
+	/**
+	 * @brief Initialized class members.
+	 *
+	 * @param clock SPI clock speed in Hz.
+	 * @param bitOrder SPI bit order.
+	 * @param dataMode SPI data mode.
+	 */
+	void init(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+	{
+		this->clock = clock;
+		border = bitOrder;
+		dmode = dataMode;
+	}
+
+	friend class SPIClass;
+};
+
+/**
+ * SPIClass class, SPI through the spidev device
+ *
+ * Every transfer selects the chip for its length. Within a transaction, writes without a result
+ * can be queued and are sent together with the next transfer, or at the end of the transaction,
+ * in a single ioctl.
+ */
+class SPIClass
+{
+
+private:
+	static uint8_t initialized; //!< @brief SPI initialized flag.
+	static const char *device; //!< @brief spidev device.
+	static int fd; //!< @brief spidev file descriptor.
+	static uint32_t speed; //!< @brief SPI clock speed in Hz.
+	static uint8_t mode; //!< @brief SPI mode and bit order as set on the device.
+	static uint8_t depth; //!< @brief Nesting depth of transactions.
+	static struct spi_ioc_transfer queue[SPI_QUEUE_TRANSFERS]; //!< @brief Queued transfers.
+	static uint8_t queued; //!< @brief Number of queued transfers.
+	static uint8_t queueData[SPI_QUEUE_SIZE]; //!< @brief Data of queued transfers.
+	static uint16_t queueUsed; //!< @brief Bytes used in queueData.
+	/**
+	 * @brief Sets SPI mode and bit order on the device.
+	 *
+	 * @param newMode SPI mode with SPI_LSB_FIRST for LSB first bit order.
+	 */
+	static void setMode(uint8_t newMode);
+	/**
+	 * @brief Sends the queued transfers and an optional transfer in one message.
+	 *
+	 * @param tbuf Sending buffer, NULL for none.
+	 * @param rbuf Receive buffer.
+	 * @param len Buffer length.
+	 */
+	static void flush(char* tbuf = NULL, char* rbuf = NULL, uint32_t len = 0);
+
+public:
+	/**
+	 * @brief Checks if SPI was initialized.
+	 *
+	 * @return 0 if wasn't initialized, else 1 or more.
+	 */
+	static uint8_t is_initialized();
+	/**
+	 * @brief Sets the spidev device, before SPI is started.
+	 *
+	 * @param spidev Path of the spidev device.
+	 */
+	static void setDevice(const char* spidev);
+	/**
+	 * @brief Send and receive a byte.
+	 *
+	 * @param data to send.
+	 * @return byte received.
+	 */
+	static uint8_t transfer(uint8_t data);
+	/**
+	 * @brief Send and receive a number of bytes.
+	 *
+	 * @param tbuf Sending buffer.
+	 * @param rbuf Receive buffer.
+	 * @param len Buffer length.
+	 */
+	static void transfernb(char* tbuf, char* rbuf, uint32_t len);
+	/**
+	 * @brief Send and receive a number of bytes.
+	 *
+	 * @param buf Buffer to read from and write to.
+	 * @param len Buffer length.
+	 */
+	static void transfern(char* buf, uint32_t len);
+	/**
+	 * @brief Queue a write, sent with the next transfer or at the end of the transaction.
+	 *
+	 * Sent immediately outside of a transaction.
+	 *
+	 * @param tbuf Sending buffer, copied.
+	 * @param len Buffer length.
+	 */
+	static void transferQueued(const char* tbuf, uint32_t len);
+	/**
+	 * @brief Send the queued writes now, e.g. before a GPIO change that must follow them.
+	 */
+	static void flushQueued();
+	/**
+	 * @brief Start SPI operations.
+	 */
+	static void begin();
+	/**
+	 * @brief End SPI operations.
+	 */
+	static void end();
+	/**
+	 * @brief Sets the SPI bit order.
+	 *
+	 * @param bit_order The desired bit order.
+	 */
+	static void setBitOrder(uint8_t bit_order);
+	/**
+	 * @brief Sets the SPI data mode.
+	 *
+	 * @param data_mode The desired data mode.
+	 */
+	static void setDataMode(uint8_t data_mode);
+	/**
+	 * @brief Sets the SPI clock divider and therefore the SPI clock speed.
+	 *
+	 * @param divider The desired SPI clock divider.
+	 */
+	static void setClockDivider(uint16_t divider);
+	/**
+	 * @brief Not implemented, the spidev device selects the chip.
+	 *
+	 * @param csn_pin ignored parameter.
+	 */
+	static void chipSelect(int csn_pin);
+	/**
+	 * @brief Start SPI transaction.
+	 *
+	 * @param settings for SPI.
+	 */
+	static void beginTransaction(SPISettings settings);
+	/**
+	 * @brief End SPI transaction, sends the queued writes.
+	 */
+	static void endTransaction();
+	/**
+	 * @brief Not implemented.
+	 *
+	 * @param interruptNumber ignored parameter.
+	 */
+	static void usingInterrupt(uint8_t interruptNumber);
+	/**
+	 * @brief Not implemented.
+	 *
+	 * @param interruptNumber ignored parameter.
+	 */
+	static void notUsingInterrupt(uint8_t interruptNumber);
+};
+
+extern SPIClass SPI;
+
+#endif
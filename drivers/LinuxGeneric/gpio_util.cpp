@@ -0,0 +1,191 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include "gpio_util.h"
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <linux/gpio.h>
+#include "log.h"
+#include "interrupt.h"
+
+#define GPIO_UTIL_PINS		(256)
+#define GPIO_UTIL_CONSUMER	"mysensors"
+
+static const char *chipName = "/dev/gpiochip0";
+static int chipFd = -1;
+
+// lineFds:
+//	Map a pin to the file descriptor of its line request, -1 if not requested
+static int lineFds[GPIO_UTIL_PINS];
+
+static int openChip()
+{
+	if (chipFd == -1) {
+		if ((chipFd = open(chipName, O_RDWR | O_CLOEXEC)) < 0) {
+			logError("Unable to open %s: %s\n", chipName, strerror(errno));
+			exit(1);
+		}
+		for (int i = 0; i < GPIO_UTIL_PINS; i++) {
+			lineFds[i] = -1;
+		}
+	}
+	return chipFd;
+}
+
+// Request the line of a pin, or change the flags of a line already requested
+static int requestLine(uint8_t pin, uint64_t flags)
+{
+	struct gpio_v2_line_config config;
+	memset(&config, 0, sizeof(config));
+	config.flags = flags;
+
+	(void)openChip();
+	if (lineFds[pin] != -1) {
+		if (ioctl(lineFds[pin], GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) < 0) {
+			logError("Unable to configure GPIO line %d: %s\n", pin, strerror(errno));
+			return -1;
+		}
+		return lineFds[pin];
+	}
+
+	struct gpio_v2_line_request request;
+	memset(&request, 0, sizeof(request));
+	request.offsets[0] = pin;
+	request.num_lines = 1;
+	request.config = config;
+	strncpy(request.consumer, GPIO_UTIL_CONSUMER, sizeof(request.consumer) - 1);
+	if (ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+		logError("Unable to request GPIO line %d of %s: %s\n", pin, chipName, strerror(errno));
+		return -1;
+	}
+	lineFds[pin] = request.fd;
+	return request.fd;
+}
+
+void gpio_util::setChip(const char *chip)
+{
+	chipName = chip;
+}
+
+void gpio_util::pinMode(uint8_t pin, uint8_t mode)
+{
+	if (pin == PIN_SPI_SS) {
+		return;
+	}
+	(void)requestLine(pin, mode == OUTPUT ? GPIO_V2_LINE_FLAG_OUTPUT : GPIO_V2_LINE_FLAG_INPUT);
+}
+
+void gpio_util::digitalWrite(uint8_t pin, uint8_t value)
+{
+	if (pin == PIN_SPI_SS) {
+		// the spidev device drives its chip select
+		return;
+	}
+	(void)openChip();
+	int fd = lineFds[pin];
+	if (fd == -1 && (fd = requestLine(pin, GPIO_V2_LINE_FLAG_OUTPUT)) == -1) {
+		return;
+	}
+	struct gpio_v2_line_values values;
+	values.bits = value ? 1 : 0;
+	values.mask = 1;
+	if (ioctl(fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0) {
+		logError("digitalWrite: failed to set pin %d: %s\n", pin, strerror(errno));
+	}
+}
+
+uint8_t gpio_util::digitalRead(uint8_t pin)
+{
+	if (pin == PIN_SPI_SS) {
+		return 0;
+	}
+	(void)openChip();
+	int fd = lineFds[pin];
+	if (fd == -1 && (fd = requestLine(pin, GPIO_V2_LINE_FLAG_INPUT)) == -1) {
+		return 0;
+	}
+	struct gpio_v2_line_values values;
+	values.bits = 0;
+	values.mask = 1;
+	if (ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+		logError("digitalRead: failed to read pin %d: %s\n", pin, strerror(errno));
+		return 0;
+	}
+	return values.bits & 1;
+}
+
+void gpio_util::attachInterrupt(uint8_t pin, void (*func)(), uint8_t mode)
+{
+	uint64_t flags = GPIO_V2_LINE_FLAG_INPUT;
+
+	switch (mode) {
+	case CHANGE:
+		flags |= GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+		break;
+	case FALLING:
+		flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+		break;
+	case RISING:
+		flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+		break;
+	case NONE:
+		break;
+	default:
+		logError("attachInterrupt: Invalid mode\n");
+		return;
+	}
+
+	// Edge detection starts with the new configuration, no stale events
+	const int fd = requestLine(pin, flags);
+	if (fd == -1) {
+		logError("attachInterrupt: Unable to attach interrupt for pin %d\n", pin);
+		exit(1);
+	}
+	interruptAttach(pin, fd, func);
+}
+
+void gpio_util::detachInterrupt(uint8_t pin)
+{
+	interruptDetach(pin);
+
+	// Release the line
+	if (chipFd != -1 && lineFds[pin] != -1) {
+		close(lineFds[pin]);
+		lineFds[pin] = -1;
+	}
+}
+
+uint8_t gpio_util::digitalPinToInterrupt(uint8_t pin)
+{
+	return pin;
+}
+
+void gpio_util::interrupts()
+{
+	interruptEnable(true);
+}
+
+void gpio_util::noInterrupts()
+{
+	interruptEnable(false);
+}
@@ -0,0 +1,81 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#ifndef gpio_util_h
+#define gpio_util_h
+
+#include <stdint.h>
+
+#ifndef HIGH
+#define HIGH 0x1
+#endif
+#ifndef LOW
+#define LOW 0x0
+#endif
+
+/**
+ * GPIO access through the GPIO character device (/dev/gpiochipN), for boards without a dedicated
+ * driver. Pin numbers are the line offsets of the chip set with gpio_util::setChip().
+ */
+namespace gpio_util
+{
+
+typedef enum {
+	LSBFIRST = 0,
+	MSBFIRST = 1
+} gpio_bitorder;
+
+typedef enum {
+	INPUT = 0,
+	OUTPUT = 1
+} gpio_pinmode;
+
+typedef enum {
+	CHANGE = 1,
+	FALLING = 2,
+	RISING = 3,
+	NONE = 4
+} gpio_pinedge;
+
+typedef enum {
+	PIN_SPI_SS = 0xFF	//!< chip select of the spidev device, driven by the kernel
+} gpio_spipins;
+
+const uint8_t SS = PIN_SPI_SS;
+
+/**
+ * @brief Set the GPIO chip device, before the first pin is used.
+ *
+ * @param chip Path of the GPIO chip device.
+ */
+void setChip(const char *chip);
+
+/* Some useful arduino functions */
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+uint8_t digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*func)(), uint8_t mode);
+void detachInterrupt(uint8_t pin);
+uint8_t digitalPinToInterrupt(uint8_t pin);
+void interrupts();
+void noInterrupts();
+
+}
+
+#endif
@@ -27,9 +27,21 @@ LOCAL uint8_t MY_RF24_NODE_ADDRESS = AUTO;
 
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
 LOCAL RF24_receiveCallbackType RF24_receiveCallback = NULL;
+LOCAL RF24_ackPayloadSentCallbackType RF24_ackPayloadSentCallback = NULL;
+// TX FIFO emptied and MAX_RT, set by the IRQ handler and reset by the sender
+LOCAL volatile bool RF24_txEmpty = false;
+LOCAL volatile bool RF24_txFailed = false;
 #endif
 
-#ifdef LINUX_ARCH_RASPBERRYPI
+// shadow copy of the configuration registers in RF24_SHADOW_REGISTERS, bit n of valid set for register n
+LOCAL uint8_t RF24_shadow[RF24_SHADOW_SIZE];
+LOCAL uint32_t RF24_shadowValid = 0;
+
+#if !defined(__linux__) && !defined(MY_SOFTSPI)
+LOCAL uint8_t RF24_transactionDepth = 0;
+#endif
+
+#if defined(LINUX_ARCH_RASPBERRYPI) || defined(LINUX_ARCH_GENERIC)
 uint8_t spi_rxbuff[32+1] ; //SPI receive buffer (payload max 32 bytes)
 uint8_t spi_txbuff[32+1] ; //SPI transmit buffer (payload max 32 bytes + 1 byte for the command)
 #endif
@@ -41,24 +53,54 @@ LOCAL void RF24_csn(const bool level)
 
 LOCAL void RF24_ce(const bool level)
 {
+#if defined(LINUX_ARCH_GENERIC)
+	// register writes queued in the open transaction must reach the chip before CE switches the mode
+	_SPI.flushQueued();
+#endif
 	hwDigitalWrite(MY_RF24_CE_PIN, level);
 }
 
+LOCAL void RF24_beginTransaction(void)
+{
+#if defined(__linux__)
+	// the SPI lock is recursive, the IRQ thread waits until the whole sequence is done
+	_SPI.beginTransaction(SPISettings(MY_RF24_SPI_MAX_SPEED, MY_RF24_SPI_DATA_ORDER,
+	                                  MY_RF24_SPI_DATA_MODE));
+#elif !defined(MY_SOFTSPI)
+	// the transaction masks the RF24 IRQ, the handler cannot run while it is open
+	if (!RF24_transactionDepth) {
+		_SPI.beginTransaction(SPISettings(MY_RF24_SPI_MAX_SPEED, MY_RF24_SPI_DATA_ORDER,
+		                                  MY_RF24_SPI_DATA_MODE));
+	}
+	RF24_transactionDepth++;
+#endif
+}
+
+LOCAL void RF24_endTransaction(void)
+{
+#if defined(__linux__)
+	_SPI.endTransaction();
+#elif !defined(MY_SOFTSPI)
+	if (!--RF24_transactionDepth) {
+		_SPI.endTransaction();
+	}
+#endif
+}
+
 LOCAL uint8_t RF24_spiMultiByteTransfer(const uint8_t cmd, uint8_t* buf, uint8_t len,
                                         const bool aReadMode)
 {
 	uint8_t status;
 	uint8_t* current = buf;
-#if !defined(MY_SOFTSPI)
-	_SPI.beginTransaction(SPISettings(MY_RF24_SPI_MAX_SPEED, MY_RF24_SPI_DATA_ORDER,
-	                                  MY_RF24_SPI_DATA_MODE));
-#endif
+	RF24_beginTransaction();
+	// CSN setup (2ns) and inactive time (50ns) are shorter than the pin write itself
 	RF24_csn(LOW);
-	// timing
-	delayMicroseconds(10);
-#ifdef LINUX_ARCH_RASPBERRYPI
+#if defined(LINUX_ARCH_RASPBERRYPI) || defined(LINUX_ARCH_GENERIC)
 	uint8_t * prx = spi_rxbuff;
 	uint8_t * ptx = spi_txbuff;
+	if (len > RF24_MAX_PAYLOAD_SIZE) {
+		len = RF24_MAX_PAYLOAD_SIZE;
+	}
 	uint8_t size = len + 1; // Add register value to transmit buffer
 
 	*ptx++ = cmd;
@@ -69,6 +111,15 @@ LOCAL uint8_t RF24_spiMultiByteTransfer(const uint8_t cmd, uint8_t* buf, uint8_t
 			*ptx++ = *current++;
 		}
 	}
+#if defined(LINUX_ARCH_GENERIC)
+	if (!aReadMode && size > 1 && MY_RF24_CS_PIN == SS) {
+		// nothing to read back, sent with the next transfer of the transaction in one ioctl.
+		// The status is not returned, no caller of a write uses it.
+		_SPI.transferQueued((const char *) spi_txbuff, size);
+		RF24_endTransaction();
+		return 0;
+	}
+#endif
 	_SPI.transfernb( (char *) spi_txbuff, (char *) spi_rxbuff, size);
 	if (aReadMode) {
 		if (size == 2) {
@@ -76,7 +127,7 @@ LOCAL uint8_t RF24_spiMultiByteTransfer(const uint8_t cmd, uint8_t* buf, uint8_t
 		} else {
 			status = *prx++; // status is 1st byte of receive buffer
 			// decrement before to skip status byte
-			while (--size) {
+			while (--size && buf != NULL) {
 				*buf++ = *prx++;
 			}
 		}
@@ -97,11 +148,7 @@ LOCAL uint8_t RF24_spiMultiByteTransfer(const uint8_t cmd, uint8_t* buf, uint8_t
 	}
 #endif
 	RF24_csn(HIGH);
-#if !defined(MY_SOFTSPI)
-	_SPI.endTransaction();
-#endif
-	// timing
-	delayMicroseconds(10);
+	RF24_endTransaction();
 	return status;
 }
 
@@ -119,6 +166,16 @@ LOCAL uint8_t RF24_RAW_readByteRegister(const uint8_t cmd)
 
 LOCAL uint8_t RF24_RAW_writeByteRegister(const uint8_t cmd, uint8_t value)
 {
+	const uint8_t reg = cmd & RF24_REGISTER_MASK;
+	if ((cmd & ~RF24_REGISTER_MASK) == RF24_WRITE_REGISTER && reg < RF24_SHADOW_SIZE &&
+	        (RF24_SHADOW_REGISTERS & ((uint32_t)1 << reg))) {
+		if ((RF24_shadowValid & ((uint32_t)1 << reg)) && RF24_shadow[reg] == value) {
+			// register holds the value already
+			return 0;
+		}
+		RF24_shadow[reg] = value;
+		RF24_shadowValid |= (uint32_t)1 << reg;
+	}
 	RF24_DEBUG(PSTR("RF24:write register, reg=%d, value=%d\n"), cmd & RF24_REGISTER_MASK, value);
 	return RF24_spiMultiByteTransfer( cmd , &value, 1, false);
 }
@@ -192,6 +249,9 @@ LOCAL void RF24_setRFConfiguration(const uint8_t configuration)
 
 LOCAL void RF24_setPipeAddress(const uint8_t pipe, uint8_t* address, const uint8_t width)
 {
+	if (pipe < RF24_SHADOW_SIZE) {
+		RF24_shadowValid &= ~((uint32_t)1 << pipe);
+	}
 	RF24_writeMultiByteRegister(pipe, address, width);
 }
 
@@ -239,11 +299,10 @@ LOCAL void RF24_stopListening(void)
 {
 	RF24_DEBUG(PSTR("RF24:STP LIS\n"));	// stop listening
 	RF24_ce(LOW);
-	// timing
+	// let a pending auto-ACK (with payload) go out before PRIM_RX is cleared
 	delayMicroseconds(130);
+	// stays powered up, TX settling (130us) starts with CE high and is timed by the chip
 	RF24_setRFConfiguration(MY_RF24_CONFIGURATION | _BV(RF24_PWR_UP) );
-	// timing
-	delayMicroseconds(100);
 }
 
 LOCAL void RF24_powerDown(void)
@@ -253,38 +312,93 @@ LOCAL void RF24_powerDown(void)
 	RF24_DEBUG(PSTR("RF24:PD\n")); // power down
 }
 
+// Wait for the end of the transmission, returns _BV(RF24_TX_DS) if the TX FIFO was emptied,
+// _BV(RF24_MAX_RT) if the payload was not acknowledged, 0 on timeout.
+LOCAL uint8_t RF24_waitTX(void)
+{
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	// the IRQ handler reports the empty FIFO and MAX_RT, no SPI traffic while waiting
+	const uint32_t enterMS = hwMillis();
+	while (!RF24_txEmpty && !RF24_txFailed) {
+		if (hwMillis() - enterMS > RF24_TX_TIMEOUT_MS) {
+			// IRQ missed, e.g. pin not connected
+			uint8_t status = RF24_getStatus() & (_BV(RF24_TX_DS) | _BV(RF24_MAX_RT));
+			RF24_setStatus(status);
+			if (!(status & _BV(RF24_MAX_RT)) && (RF24_getFIFOStatus() & _BV(RF24_TX_EMPTY))) {
+				return _BV(RF24_TX_DS);
+			}
+			return status & _BV(RF24_MAX_RT);
+		}
+#if defined(__linux__)
+		// sleep, the IRQ handler runs in its own thread
+		usleep(50);
+#endif
+	}
+	return RF24_txFailed ? _BV(RF24_MAX_RT) : _BV(RF24_TX_DS);
+#else
+	uint8_t status;
+	// timeout counter to detect HW issues
+	uint16_t timeout = 0xFFFF;
+	do {
+		status = RF24_getStatus() & (_BV(RF24_TX_DS) | _BV(RF24_MAX_RT));
+		if (status == _BV(RF24_TX_DS)) {
+			// acknowledged, done when the FIFO is empty
+			RF24_setStatus(status);
+			status = (RF24_getFIFOStatus() & _BV(RF24_TX_EMPTY)) ? status : 0;
+		}
+	} while (!status && timeout--);
+	// timeout value after successful TX on 16Mhz AVR ~ 65500, i.e. msg is transmitted after ~36 loop cycles
+	// reset interrupts
+	RF24_setStatus(status);
+	return status & _BV(RF24_MAX_RT) ? _BV(RF24_MAX_RT) : status;
+#endif
+}
+
 LOCAL bool RF24_sendMessage(const uint8_t recipient, const void* buf, const uint8_t len)
 {
-	uint8_t RF24_status;
+	const uint8_t payloadLen = len > RF24_MAX_PAYLOAD_SIZE ? RF24_MAX_PAYLOAD_SIZE : len;
+	// switch to TX and load the payload in one SPI transaction
+	RF24_beginTransaction();
 	RF24_stopListening();
 	RF24_openWritingPipe( recipient );
-	RF24_DEBUG(PSTR("RF24:SND:TO=%d,LEN=%d\n"),recipient,len); // send message
-	// flush TX FIFO
+	RF24_DEBUG(PSTR("RF24:SND:TO=%d,LEN=%d\n"),recipient,payloadLen); // send message
+	// flush TX FIFO, this drops a preloaded ACK payload as well
 	RF24_flushTX();
+	// TX_DS of an ACK payload sent in RX mode may be pending
+	RF24_setStatus(_BV(RF24_TX_DS) | _BV(RF24_MAX_RT));
 	// this command is affected in clones (e.g. Si24R1):  flipped NoACK bit when using W_TX_PAYLOAD_NO_ACK / W_TX_PAYLOAD
 	// AutoACK is disabled on the broadcasting pipe - NO_ACK prevents resending
 	RF24_spiMultiByteTransfer(recipient == BROADCAST_ADDRESS ? RF24_WRITE_TX_PAYLOAD_NO_ACK :
-	                          RF24_WRITE_TX_PAYLOAD, (uint8_t*)buf, len, false );
+	                          RF24_WRITE_TX_PAYLOAD, (uint8_t*)buf, payloadLen, false );
+	RF24_endTransaction();
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	RF24_txEmpty = false;
+	RF24_txFailed = false;
+#endif
 	// go, TX starts after ~10us
 	RF24_ce(HIGH);
-	// timeout counter to detect HW issues
-	uint16_t timeout = 0xFFFF;
-	do {
-		RF24_status = RF24_getStatus();
-	} while  (!(RF24_status & ( _BV(RF24_MAX_RT) | _BV(RF24_TX_DS) )) && timeout--);
-	// timeout value after successful TX on 16Mhz AVR ~ 65500, i.e. msg is transmitted after ~36 loop cycles
+	const bool delivered = RF24_waitTX() & _BV(RF24_TX_DS);
 	RF24_ce(LOW);
-	// reset interrupts
-	RF24_setStatus(_BV(RF24_TX_DS) | _BV(RF24_MAX_RT) );
-	// Max retries exceeded
-	if(RF24_status & _BV(RF24_MAX_RT)) {
-		// flush packet
+	RF24_beginTransaction();
+	if (!delivered) {
+		// Max retries exceeded, flush packet
 		RF24_DEBUG(PSTR("!RF24:SND:MAX_RT\n"));	// max retries, no ACK
 		RF24_flushTX();
 	}
 	RF24_startListening();
+	RF24_endTransaction();
 	// true if message sent
-	return (RF24_status & _BV(RF24_TX_DS));
+	return delivered;
+}
+
+LOCAL void RF24_writeAckPayload(const void* buf, const uint8_t len)
+{
+	RF24_DEBUG(PSTR("RF24:WAP:LEN=%d\n"), len);	// write ACK payload
+	RF24_beginTransaction();
+	RF24_flushTX();
+	RF24_spiMultiByteTransfer(RF24_WRITE_ACK_PAYLOAD | RF24_NODE_PIPE, (uint8_t*)buf,
+	                          len > RF24_MAX_PAYLOAD_SIZE ? RF24_MAX_PAYLOAD_SIZE : len, false);
+	RF24_endTransaction();
 }
 
 LOCAL uint8_t RF24_getDynamicPayloadSize(void)
@@ -307,11 +421,13 @@ LOCAL bool RF24_isDataAvailable(void)
 
 LOCAL uint8_t RF24_readMessage(void* buf)
 {
+	RF24_beginTransaction();
 	const uint8_t len = RF24_getDynamicPayloadSize();
 	RF24_DEBUG(PSTR("RF24:RDM:MSG LEN=%d\n"), len);	// read message
 	RF24_spiMultiByteTransfer(RF24_READ_RX_PAYLOAD,(uint8_t*)buf,len,true);
 	// clear RX interrupt
 	RF24_setStatus(_BV(RF24_RX_DR));
+	RF24_endTransaction();
 	return len;
 }
 
@@ -341,6 +457,13 @@ LOCAL bool RF24_sanityCheck(void)
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
 LOCAL void RF24_irqHandler(void)
 {
+	// end of transmission, de-assert IRQ
+	const uint8_t status = RF24_getStatus() & (_BV(RF24_TX_DS) | _BV(RF24_MAX_RT));
+	bool txEmpty = false;
+	if (status) {
+		RF24_setStatus(status);
+		txEmpty = (status & _BV(RF24_TX_DS)) && (RF24_getFIFOStatus() & _BV(RF24_TX_EMPTY));
+	}
 	if (RF24_receiveCallback) {
 		// Will stay for a while (several 100us) in this interrupt handler. Any interrupts from serial
 		// rx coming in during our stay will not be handled and will cause characters to be lost.
@@ -360,6 +483,10 @@ LOCAL void RF24_irqHandler(void)
 		while (RF24_isDataAvailable()) {
 			RF24_receiveCallback();		// Must call RF24_readMessage(), which will clear RX_DR IRQ !
 		}
+		// the ACK carrying a preloaded payload went to the sender of a message read by now
+		if ((status & _BV(RF24_TX_DS)) && RF24_ackPayloadSentCallback) {
+			RF24_ackPayloadSentCallback();
+		}
 		// Restore our interrupt handler.
 #if defined(MY_GATEWAY_SERIAL) && !defined(__linux__)
 		noInterrupts();
@@ -369,6 +496,13 @@ LOCAL void RF24_irqHandler(void)
 		// clear RX interrupt
 		RF24_setStatus(_BV(RF24_RX_DR));
 	}
+	// report to RF24_sendMessage() last, the sender continues once this handler is done
+	if (txEmpty) {
+		RF24_txEmpty = true;
+	}
+	if (status & _BV(RF24_MAX_RT)) {
+		RF24_txFailed = true;
+	}
 }
 
 LOCAL void RF24_registerReceiveCallback(RF24_receiveCallbackType cb)
@@ -377,13 +511,26 @@ LOCAL void RF24_registerReceiveCallback(RF24_receiveCallbackType cb)
 		RF24_receiveCallback = cb;
 	}
 }
+
+LOCAL void RF24_registerAckPayloadSentCallback(RF24_ackPayloadSentCallbackType cb)
+{
+	MY_CRITICAL_SECTION {
+		RF24_ackPayloadSentCallback = cb;
+	}
+}
 #endif
 
 LOCAL bool RF24_initialize(void)
 {
 	// prevent warning
 	(void)RF24_getObserveTX;
+	(void)RF24_writeAckPayload;
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	(void)RF24_registerAckPayloadSentCallback;
+#endif
 
+	// register content unknown until written
+	RF24_shadowValid = 0;
 	// Initialize pins
 	hwPinMode(MY_RF24_CE_PIN,OUTPUT);
 	hwPinMode(MY_RF24_CS_PIN,OUTPUT);
@@ -48,7 +48,7 @@ _SPI;
 
 #define _BV(x) (1<<(x))
 
-#if defined(__arm__)
+#if defined(__arm__) || defined(__linux__)
 #include <SPI.h>
 #else
 extern HardwareSPI SPI;
@@ -82,15 +82,16 @@ extern HardwareSPI SPI;
 #endif
 
 
-// RF24 settings
-#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
-#define MY_RF24_CONFIGURATION (uint8_t) ((RF24_CRC_16 << 2) | (1 << RF24_MASK_TX_DS) | (1 << RF24_MASK_MAX_RT))
-#else
+// RF24 settings, with the IRQ pin connected TX_DS and MAX_RT signal the end of a transmission
 #define MY_RF24_CONFIGURATION (uint8_t) (RF24_CRC_16 << 2)
-#endif
 #define MY_RF24_FEATURE (uint8_t)( _BV(RF24_EN_DPL) | _BV(RF24_EN_ACK_PAY) )
 #define MY_RF24_RF_SETUP (uint8_t)( ((MY_RF24_DATARATE & 0b10 ) << 4) | ((MY_RF24_DATARATE & 0b01 ) << 3) | (MY_RF24_PA_LEVEL << 1) ) + 1 // +1 for Si24R1
 
+// configuration registers with a shadow copy, writes of unchanged values are skipped.
+// Of the address registers only the LSB is shadowed, as written by RF24_setPipeLSB().
+#define RF24_SHADOW_SIZE		(RF24_TX_ADDR + 1)
+#define RF24_SHADOW_REGISTERS	((uint32_t)0x7F | ((uint32_t)1 << RF24_RX_ADDR_P0) | ((uint32_t)1 << RF24_TX_ADDR))
+
 // pipes
 #define RF24_BROADCAST_PIPE		(1)
 #define RF24_NODE_PIPE			(0)
@@ -124,6 +125,12 @@ extern HardwareSPI SPI;
 // ARD, auto retry count
 #define RF24_SET_ARC		(15)
 
+// max. payload length, longer payloads are truncated
+#define RF24_MAX_PAYLOAD_SIZE	(32u)
+
+// TX completion timeout in ms, a transmission with all retries takes ~25ms
+#define RF24_TX_TIMEOUT_MS	(50ul)
+
 // nRF24L01(+) register definitions
 #define RF24_NRF_CONFIG		(0x00)
 #define RF24_EN_AA			(0x01)
@@ -235,6 +242,11 @@ extern HardwareSPI SPI;
 
 LOCAL void RF24_csn(const bool level);
 LOCAL void RF24_ce(const bool level);
+/**
+ * Start a sequence of SPI commands in one SPI transaction, nested calls join the open transaction.
+ */
+LOCAL void RF24_beginTransaction(void);
+LOCAL void RF24_endTransaction(void);
 LOCAL uint8_t RF24_spiMultiByteTransfer(const uint8_t cmd, uint8_t* buf, const uint8_t len,
                                         const bool aReadMode);
 LOCAL uint8_t RF24_spiByteTransfer(const uint8_t cmd);
@@ -254,6 +266,11 @@ LOCAL void RF24_startListening(void);
 LOCAL void RF24_stopListening(void);
 LOCAL void RF24_powerDown(void);
 LOCAL bool RF24_sendMessage(const uint8_t recipient, const void* buf, const uint8_t len);
+/**
+ * Preload a payload sent with the ACK of the next message received on the node pipe,
+ * replaces a payload not sent yet. The payload is dropped when sending.
+ */
+LOCAL void RF24_writeAckPayload(const void* buf, const uint8_t len);
 LOCAL uint8_t RF24_getDynamicPayloadSize(void);
 LOCAL bool RF24_isDataAvailable(void);
 LOCAL uint8_t RF24_readMessage(void* buf);
@@ -285,6 +302,13 @@ typedef void (*RF24_receiveCallbackType)(void);
  * and message reception will stop.
  */
 LOCAL void RF24_registerReceiveCallback(RF24_receiveCallbackType cb);
+typedef void (*RF24_ackPayloadSentCallbackType)(void);
+/**
+ * Register a callback, which will be called (from interrupt context) for every TX_DS, i.e. when the
+ * preloaded ACK payload was sent or a message was acknowledged. It is called after
+ * the messages received in the same interrupt were read.
+ */
+LOCAL void RF24_registerAckPayloadSentCallback(RF24_ackPayloadSentCallbackType cb);
 #endif
 
 #endif // __RF24_H__
\ No newline at end of file
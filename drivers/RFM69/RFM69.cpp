@@ -44,6 +44,10 @@ RFM69::ACK_RECEIVED; // should be polled immediately after sending a packet with
 volatile int16_t
 RFM69::RSSI;          // most accurate RSSI during reception (closest to the reception)
 RFM69* RFM69::selfPointer;
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+CircularBuffer<rfm69_queuedFrame_t, MY_RX_MESSAGE_BUFFER_SIZE> RFM69::_rxQueue;
+size_t RFM69::_rxPeeked = 0;      // frames handed out by peek() and not dequeued yet
+#endif
 
 bool RFM69::initialize(uint8_t freqBand, uint8_t nodeID, uint8_t networkID)
 {
@@ -256,6 +260,12 @@ void RFM69::send(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool
 bool RFM69::sendWithRetry(uint8_t toAddress, const void* buffer, uint8_t bufferSize,
                           uint8_t retries, uint8_t retryWaitTime)
 {
+#if defined(MY_RFM69_GW_BACKGROUND_SEND)
+	// complete a send in progress first
+	while (sendProcess()) {
+		yield();
+	}
+#endif
 	for (uint8_t i = 0; i <= retries; i++) {
 		send(toAddress, buffer, bufferSize, true);
 		uint32_t sentTime = millis();
@@ -270,6 +280,80 @@ bool RFM69::sendWithRetry(uint8_t toAddress, const void* buffer, uint8_t bufferS
 	return false;
 }
 
+#if defined(MY_RFM69_GW_BACKGROUND_SEND)
+// same as sendWithRetry, but returns at once: the send is advanced by calling sendProcess()
+// until it returns false, the receiver keeps running meanwhile and the callback reports the result
+bool RFM69::sendStart(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries,
+                      uint8_t retryWaitTime)
+{
+	if (_txState != RF69_SEND_IDLE) {
+		return false;
+	}
+	if (bufferSize > RF69_MAX_DATA_LEN) {
+		bufferSize = RF69_MAX_DATA_LEN;
+	}
+	memcpy(_txBuffer, buffer, bufferSize);
+	_txLen = bufferSize;
+	_txTo = toAddress;
+	_txRetries = retries;
+	_txRetryWaitTime = retryWaitTime;
+	writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) |
+	         RF_PACKET2_RXRESTART); // avoid RX deadlocks
+	_txTimer = millis();
+	_txState = RF69_SEND_CSMA;
+	(void)sendProcess();
+	return true;
+}
+
+bool RFM69::sendProcess()
+{
+	switch (_txState) {
+	case RF69_SEND_CSMA:
+		// like send(), the frame goes out anyway if the channel stays busy
+		if (canSend() || millis() - _txTimer >= RF69_CSMA_LIMIT_MS) {
+			sendFrame(_txTo, _txBuffer, _txLen, true, false);
+			_txTimer = millis();
+			_txState = RF69_SEND_WAIT_ACK;
+		}
+		// keep receiving, after the frame went out for the ACK
+		(void)receiveDone();
+		break;
+	case RF69_SEND_WAIT_ACK:
+		if (ACKReceived(_txTo)) {
+			sendDone(true);
+		} else if (millis() - _txTimer >= _txRetryWaitTime) {
+			if (_txRetries) {
+				_txRetries--;
+				writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) |
+				         RF_PACKET2_RXRESTART); // avoid RX deadlocks
+				_txTimer = millis();
+				_txState = RF69_SEND_CSMA;
+			} else {
+				sendDone(false);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	return _txState != RF69_SEND_IDLE;
+}
+
+void RFM69::setSendCallback(rfm69_sendCallback_t cb)
+{
+	_sendCallback = cb;
+}
+
+// internal function
+void RFM69::sendDone(bool success)
+{
+	_txState = RF69_SEND_IDLE;
+	if (_sendCallback != NULL) {
+		_sendCallback(_txTo, success);
+	}
+}
+#endif
+
 // should be polled immediately after sending a packet with ACK request
 bool RFM69::ACKReceived(uint8_t fromNodeID)
 {
@@ -292,6 +376,14 @@ void RFM69::sendACK(const void* buffer, uint8_t bufferSize)
 	    0;   // TWS added to make sure we don't end up in a timing race and infinite loop sending Acks
 	uint8_t sender = SENDERID;
 	int16_t _RSSI = RSSI; // save payload received RSSI value
+	sendACKFrame(sender, buffer, bufferSize);
+	SENDERID = sender;    // TWS: Restore SenderID after it gets wiped out by receiveDone()
+	RSSI = _RSSI; // restore payload RSSI
+}
+
+// internal function
+void RFM69::sendACKFrame(uint8_t toAddress, const void* buffer, uint8_t bufferSize)
+{
 	writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) |
 	         RF_PACKET2_RXRESTART); // avoid RX deadlocks
 	uint32_t now = millis();
@@ -299,9 +391,7 @@ void RFM69::sendACK(const void* buffer, uint8_t bufferSize)
 		receiveDone();
 		yield();
 	}
-	SENDERID = sender;    // TWS: Restore SenderID after it gets wiped out by receiveDone()
-	sendFrame(sender, buffer, bufferSize, false, true);
-	RSSI = _RSSI; // restore payload RSSI
+	sendFrame(toAddress, buffer, bufferSize, false, true);
 }
 
 void RFM69::interruptHook(uint8_t CTLbyte)
@@ -358,6 +448,9 @@ void RFM69::interruptHandler()
 	//hwDigitalWrite(4, 1);
 	if (_mode == RF69_MODE_RX && (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY)) {
 		//RSSI = readRSSI();
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+		const int16_t frameRSSI = readRSSI();
+#endif
 		setMode(RF69_MODE_STANDBY);
 		select();
 		SPI.transfer(REG_FIFO & 0x7F);
@@ -376,9 +469,36 @@ void RFM69::interruptHandler()
 			return;
 		}
 
-		DATALEN = PAYLOADLEN - 3;
-		SENDERID = SPI.transfer(0);
+		const uint8_t sender = SPI.transfer(0);
 		uint8_t CTLbyte = SPI.transfer(0);
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+		if (!(CTLbyte & RFM69_CTL_SENDACK)) {
+			// queue the frame, ACKs stay in DATA for ACKReceived()
+			interruptHook(CTLbyte);
+			rfm69_queuedFrame_t* frame = _rxQueue.getFront();
+			if (frame != NULL && PAYLOADLEN <= MAX_MESSAGE_LENGTH + 3) {
+				frame->senderId = sender;
+				frame->targetId = TARGETID;
+				frame->ctlByte = CTLbyte;
+				frame->rssi = frameRSSI;
+				frame->released = false;
+				frame->dataLen = PAYLOADLEN - 3;
+				for (uint8_t i = 0; i < frame->dataLen; i++) {
+					frame->data[i] = SPI.transfer(0);
+				}
+				frame->data[frame->dataLen] = 0; // add null at end of string
+				(void)_rxQueue.pushFront(frame);
+			}
+			// dropped if the queue is full or the frame exceeds a message, the FIFO is cleared when leaving standby
+			PAYLOADLEN = 0;
+			TARGETID = 0;
+			unselect();
+			setMode(RF69_MODE_RX);
+			return;
+		}
+#endif
+		DATALEN = PAYLOADLEN - 3;
+		SENDERID = sender;
 
 		ACK_RECEIVED = CTLbyte & RFM69_CTL_SENDACK; // extract ACK-received flag
 		ACK_REQUESTED = CTLbyte & RFM69_CTL_REQACK; // extract ACK-requested flag
@@ -440,6 +560,50 @@ bool RFM69::receiveDone()
 	//}
 }
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+// checks if a queued frame was not handed out yet and keeps the transceiver in receive mode
+bool RFM69::available()
+{
+	if (receiveDone()) {
+		// ACK nobody waits for
+		receiveBegin();
+	}
+	return _rxQueue.available() > _rxPeeked;
+}
+
+// hands out the next queued frame, to be processed in place and released
+uint8_t* RFM69::peek(uint8_t* len)
+{
+	(void)available();
+	// frames before it are still processed if processing nests
+	rfm69_queuedFrame_t* frame = _rxQueue.getBack(_rxPeeked);
+	if (frame == NULL) {
+		return NULL;
+	}
+	_rxPeeked++;
+	RSSI = frame->rssi;
+	if ((frame->ctlByte & RFM69_CTL_REQACK) && frame->targetId != RF69_BROADCAST_ADDR) {
+		sendACKFrame(frame->senderId, "", 0);
+		(void)receiveDone();
+		RSSI = frame->rssi; // ACK handling resets the RSSI
+	}
+	*len = frame->dataLen;
+	return frame->data;
+}
+
+// releases a frame handed out by peek
+void RFM69::release(uint8_t* data)
+{
+	rfm69_queuedFrame_t* frame = (rfm69_queuedFrame_t*)(data - offsetof(rfm69_queuedFrame_t, data));
+	frame->released = true;
+	// dequeue in order, the space of a frame is freed once the older ones are released too
+	while (_rxPeeked && (frame = _rxQueue.getBack()) != NULL && frame->released) {
+		(void)_rxQueue.popBack();
+		_rxPeeked--;
+	}
+}
+#endif
+
 // To enable encryption: radio.encrypt("ABCDEFGHIJKLMNOP");
 // To disable encryption: radio.encrypt(null) or radio.encrypt(0)
 // KEY HAS TO BE 16 bytes !!!
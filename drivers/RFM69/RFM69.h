@@ -78,6 +78,31 @@
 #define RFM69_CTL_SENDACK   0x80
 #define RFM69_CTL_REQACK    0x40
 
+#if defined(MY_RFM69_GW_BACKGROUND_SEND)
+// send states
+#define RF69_SEND_IDLE      0 // no send in progress
+#define RF69_SEND_CSMA      1 // waiting for a free channel
+#define RF69_SEND_WAIT_ACK  2 // frame sent, waiting for the ACK
+
+/** Called when a send started with sendStart() completes, success is false if no ACK was received */
+typedef void (*rfm69_sendCallback_t)(uint8_t toAddress, bool success);
+#endif
+
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+#include "drivers/CircularBuffer/CircularBuffer.h"
+
+/** Frame queued by the interrupt handler, longer frames than a message are dropped */
+typedef struct {
+	uint8_t senderId; //!< Sender
+	uint8_t targetId; //!< Target, RF69_BROADCAST_ADDR for broadcasts
+	uint8_t ctlByte; //!< Control byte
+	uint8_t dataLen; //!< Length of data
+	int16_t rssi; //!< RSSI of the frame
+	bool released; //!< Released by the consumer, waiting for the frames before it
+	uint8_t data[MAX_MESSAGE_LENGTH + 1]; //!< Data, null terminated
+} rfm69_queuedFrame_t;
+#endif
+
 /** RFM69 class */
 class RFM69
 {
@@ -112,6 +137,10 @@ public:
 		_powerLevel = 31;
 		_isRFM69HW = isRFM69HW;
 		_address = RF69_BROADCAST_ADDR;
+#if defined(MY_RFM69_GW_BACKGROUND_SEND)
+		_txState = RF69_SEND_IDLE;
+		_sendCallback = NULL;
+#endif
 #if defined (SPCR) && defined (SPSR)
 		_SPCR = 0;
 		_SPSR = 0;
@@ -127,6 +156,12 @@ public:
 	virtual bool sendWithRetry(uint8_t toAddress, const void* buffer, uint8_t bufferSize,
 	                           uint8_t retries=2, uint8_t retryWaitTime=
 	                               40); //!< sendWithRetry (40ms roundtrip req for 61byte packets)
+#if defined(MY_RFM69_GW_BACKGROUND_SEND)
+	bool sendStart(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries=2,
+	               uint8_t retryWaitTime=40); //!< sendStart (non-blocking sendWithRetry, false if a send is in progress)
+	bool sendProcess(); //!< sendProcess (advance the send in progress, true until it completes)
+	void setSendCallback(rfm69_sendCallback_t cb); //!< setSendCallback (completion of sends)
+#endif
 	virtual bool receiveDone(); //!< receiveDone
 	bool ACKReceived(uint8_t fromNodeID); //!< ACKReceived
 	bool ACKRequested(); //!< ACKRequested
@@ -143,6 +178,11 @@ public:
 	void sleep(); //!< sleep
 	uint8_t readTemperature(uint8_t calFactor=0); //!< readTemperature (get CMOS temperature (8bit))
 	void rcCalibration(); //!< rcCalibration (calibrate the internal RC oscillator for use in wide temperature variations - see datasheet section [4.3.5. RC Timer Accuracy])
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	bool available(); //!< available (queued frame not handed out yet, keeps the transceiver receiving)
+	uint8_t* peek(uint8_t* len); //!< peek (hand out the next queued frame, sends the ACK if requested)
+	void release(uint8_t* data); //!< release (frame handed out by peek processed)
+#endif
 
 	// allow hacking registers by making these public
 	uint8_t readReg(uint8_t addr); //!< readReg
@@ -155,6 +195,11 @@ protected:
 	virtual void interruptHook(uint8_t CTLbyte); //!< interruptHook
 	virtual void sendFrame(uint8_t toAddress, const void* buffer, uint8_t size, bool requestACK=false,
 	                       bool sendACK=false); //!< sendFrame
+	void sendACKFrame(uint8_t toAddress, const void* buffer,
+	                  uint8_t bufferSize); //!< sendACKFrame (waits for a free channel)
+#if defined(MY_RFM69_GW_BACKGROUND_SEND)
+	void sendDone(bool success); //!< sendDone
+#endif
 
 	static RFM69* selfPointer; //!< selfPointer
 	uint8_t _slaveSelectPin; //!< _slaveSelectPin
@@ -164,10 +209,24 @@ protected:
 	bool _promiscuousMode; //!< _promiscuousMode
 	uint8_t _powerLevel; //!< _powerLevel
 	bool _isRFM69HW; //!< _isRFM69HW
+#if defined(MY_RFM69_GW_BACKGROUND_SEND)
+	uint8_t _txBuffer[RF69_MAX_DATA_LEN]; //!< _txBuffer (frame of the send in progress)
+	uint8_t _txLen; //!< _txLen
+	uint8_t _txTo; //!< _txTo
+	uint8_t _txRetries; //!< _txRetries (retries left)
+	uint8_t _txRetryWaitTime; //!< _txRetryWaitTime
+	uint8_t _txState; //!< _txState
+	uint32_t _txTimer; //!< _txTimer (start of the CSMA or ACK wait)
+	rfm69_sendCallback_t _sendCallback; //!< _sendCallback
+#endif
 #if defined (SPCR) && defined (SPSR)
 	uint8_t _SPCR; //!< _SPCR
 	uint8_t _SPSR; //!< _SPSR
 #endif
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	static CircularBuffer<rfm69_queuedFrame_t, MY_RX_MESSAGE_BUFFER_SIZE> _rxQueue; //!< _rxQueue
+	static size_t _rxPeeked; //!< _rxPeeked (frames handed out by peek and not popped yet)
+#endif
 
 	virtual void receiveBegin(); //!< receiveBegin
 	virtual void setMode(uint8_t mode); //!< setMode
@@ -24,7 +24,7 @@
 
 #include "RFM95.h"
 
-#if defined(LINUX_ARCH_RASPBERRYPI)
+#if defined(LINUX_ARCH_RASPBERRYPI) || defined(LINUX_ARCH_GENERIC)
 // SPI RX and TX buffers (max packet len + 1 byte for the command)
 uint8_t spi_rxbuff[RFM95_MAX_PACKET_LEN + 1];
 uint8_t spi_txbuff[RFM95_MAX_PACKET_LEN + 1];
@@ -32,6 +32,17 @@ uint8_t spi_txbuff[RFM95_MAX_PACKET_LEN + 1];
 
 volatile rfm95_internal_t RFM95;	//!< internal variables
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+#include "drivers/CircularBuffer/CircularBuffer.h"
+// received packets, ACKs excluded
+static CircularBuffer<rfm95_queuedPacket_t, MY_RX_MESSAGE_BUFFER_SIZE> RFM95_rxQueue;
+// packets handed out by RFM95_peek() and not dequeued yet
+static size_t RFM95_rxPeeked = 0;
+// RSSI and SNR of the packet handed out last
+static rfm95_RSSI_t RFM95_rxRSSI;
+static rfm95_SNR_t RFM95_rxSNR;
+#endif
+
 LOCAL void RFM95_csn(const bool level)
 {
 	hwDigitalWrite(MY_RFM95_SPI_CS, level);
@@ -47,15 +58,18 @@ LOCAL uint8_t RFM95_spiMultiByteTransfer(const uint8_t cmd, uint8_t* buf, uint8_
 	                                  MY_RFM95_SPI_DATA_MODE));
 #endif
 	RFM95_csn(LOW);
-#if defined(LINUX_ARCH_RASPBERRYPI)
+#if defined(LINUX_ARCH_RASPBERRYPI) || defined(LINUX_ARCH_GENERIC)
 	uint8_t * prx = spi_rxbuff;
 	uint8_t * ptx = spi_txbuff;
+	if (len > RFM95_MAX_PACKET_LEN) {
+		len = RFM95_MAX_PACKET_LEN;
+	}
 	uint8_t size = len + 1; // Add register value to transmit buffer
 
 	*ptx++ = cmd;
 	while (len--) {
 		if (aReadMode) {
-			*ptx++ = RF24_NOP;
+			*ptx++ = (uint8_t)0x00;
 		} else {
 			*ptx++ = *current++;
 		}
@@ -185,24 +199,48 @@ LOCAL void RFM95_interruptHandler(void)
 		// CRC error or timeout
 		// RXcontinuous mode: radio stays in RX mode, clearing IRQ needed
 	} else if (RFM95.radioMode == RFM95_RADIO_MODE_RX && (irqFlags & RFM95_RX_DONE)) {
+#if !defined(MY_RX_MESSAGE_BUFFER_FEATURE)
 		// set radio to STDBY (we are in RXcontinuous mode)
 		(void)RFM95_setRadioMode(RFM95_RADIO_MODE_STDBY);
+#endif
 		// Have received a packet
 		//In order to retrieve received data from FIFO the user must ensure that ValidHeader, PayloadCrcError, RxDone and RxTimeout interrupts in the status register RegIrqFlags are not asserted to ensure that packet reception has terminated successfully(i.e.no flags should be set).
 		const uint8_t bufLen = min(RFM95_readReg(RFM95_REG_13_RX_NB_BYTES), (uint8_t)RFM95_MAX_PACKET_LEN);
 		if (bufLen >= RFM95_HEADER_LEN) {
 			// Reset the fifo read ptr to the beginning of the packet
 			RFM95_writeReg(RFM95_REG_0D_FIFO_ADDR_PTR, RFM95_readReg(RFM95_REG_10_FIFO_RX_CURRENT_ADDR));
-			RFM95_burstReadReg(RFM95_REG_00_FIFO, RFM95.currentPacket.data, bufLen);
-			RFM95.currentPacket.RSSI = RFM95_readReg(
-			                               RFM95_REG_1A_PKT_RSSI_VALUE); // RSSI of latest packet received
-			RFM95.currentPacket.SNR = static_cast<rfm95_SNR_t>(RFM95_readReg(RFM95_REG_19_PKT_SNR_VALUE));
-			RFM95.currentPacket.payloadLen = bufLen - RFM95_HEADER_LEN;
+			rfm95_header_t header;
+			RFM95_burstReadReg(RFM95_REG_00_FIFO, &header, RFM95_HEADER_LEN);
 			// Message for us
-			if ((RFM95.currentPacket.header.version >= RFM95_MIN_PACKET_HEADER_VERSION) &&
-			        (RFM95_PROMISCUOUS || RFM95.currentPacket.header.recipient == RFM95.address ||
-			         RFM95.currentPacket.header.recipient == RFM95_BROADCAST_ADDRESS)) {
-				RFM95.rxBufferValid = true;
+			if ((header.version >= RFM95_MIN_PACKET_HEADER_VERSION) &&
+			        (RFM95_PROMISCUOUS || header.recipient == RFM95.address ||
+			         header.recipient == RFM95_BROADCAST_ADDRESS)) {
+				const uint8_t payloadLen = bufLen - RFM95_HEADER_LEN;
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+				if (!RFM95_getACKReceived(header.controlFlags)) {
+					// ACKs are picked up by RFM95_sendWithRetry(), other packets are queued.
+					// Dropped if the queue is full or the payload exceeds a message
+					rfm95_queuedPacket_t *queued = RFM95_rxQueue.getFront();
+					if (queued && payloadLen <= MAX_MESSAGE_LENGTH) {
+						queued->header = header;
+						RFM95_burstReadReg(RFM95_REG_00_FIFO, queued->payload, payloadLen);
+						queued->RSSI = RFM95_readReg(RFM95_REG_1A_PKT_RSSI_VALUE); // RSSI of latest packet received
+						queued->SNR = static_cast<rfm95_SNR_t>(RFM95_readReg(RFM95_REG_19_PKT_SNR_VALUE));
+						queued->payloadLen = payloadLen;
+						queued->released = false;
+						(void)RFM95_rxQueue.pushFront(queued);
+					}
+				} else
+#endif
+				{
+					rfm95_packet_t *packet = (rfm95_packet_t *)&RFM95.currentPacket;
+					packet->header = header;
+					RFM95_burstReadReg(RFM95_REG_00_FIFO, packet->payload, payloadLen);
+					packet->RSSI = RFM95_readReg(RFM95_REG_1A_PKT_RSSI_VALUE); // RSSI of latest packet received
+					packet->SNR = static_cast<rfm95_SNR_t>(RFM95_readReg(RFM95_REG_19_PKT_SNR_VALUE));
+					packet->payloadLen = payloadLen;
+					RFM95.rxBufferValid = true;
+				}
 			}
 		}
 
@@ -223,7 +261,11 @@ LOCAL bool RFM95_available(void)
 		return false;
 	}
 	(void)RFM95_setRadioMode(RFM95_RADIO_MODE_RX);
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	return RFM95_rxQueue.available() > RFM95_rxPeeked;
+#else
 	return RFM95.rxBufferValid;
+#endif
 }
 
 LOCAL void RFM95_clearRxBuffer(void)
@@ -233,6 +275,52 @@ LOCAL void RFM95_clearRxBuffer(void)
 	interrupts();
 }
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+LOCAL uint8_t* RFM95_peek(uint8_t* len)
+{
+	(void)RFM95_available();
+	// packets before it are still processed if processing nests
+	rfm95_queuedPacket_t* queued = RFM95_rxQueue.getBack(RFM95_rxPeeked);
+	if (queued == NULL) {
+		return NULL;
+	}
+	RFM95_rxPeeked++;
+	RFM95_rxRSSI = queued->RSSI;
+	RFM95_rxSNR = queued->SNR;
+	// ACK handling
+	if (RFM95_getACKRequested(queued->header.controlFlags)) {
+		RFM95_sendACK(queued->header.sender, queued->header.sequenceNumber, queued->RSSI, queued->SNR);
+	}
+	*len = queued->payloadLen;
+	return queued->payload;
+}
+
+LOCAL void RFM95_release(uint8_t* payload)
+{
+	rfm95_queuedPacket_t* queued = (rfm95_queuedPacket_t*)(payload - offsetof(rfm95_queuedPacket_t,
+	                               payload));
+	queued->released = true;
+	// dequeue in order, the space of a packet is freed once the older ones are released too
+	while (RFM95_rxPeeked && (queued = RFM95_rxQueue.getBack()) != NULL && queued->released) {
+		(void)RFM95_rxQueue.popBack();
+		RFM95_rxPeeked--;
+	}
+}
+
+LOCAL uint8_t RFM95_recv(uint8_t* buf)
+{
+	uint8_t len = 0;
+	uint8_t* payload = RFM95_peek(&len);
+	if (payload == NULL) {
+		return 0;
+	}
+	if (buf != NULL) {
+		(void)memcpy((void*)buf, (void*)payload, len);
+	}
+	RFM95_release(payload);
+	return len;
+}
+#else
 LOCAL uint8_t RFM95_recv(uint8_t* buf)
 {
 	if (!RFM95_available()) {
@@ -260,6 +348,7 @@ LOCAL uint8_t RFM95_recv(uint8_t* buf)
 
 	return payloadLen;
 }
+#endif
 
 LOCAL bool RFM95_send(rfm95_packet_t &packet)
 {
@@ -529,13 +618,21 @@ LOCAL int8_t RFM95_getSendingSNR(void)
 LOCAL int16_t RFM95_getReceivingRSSI(void)
 {
 	// RSSI from last received packet
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	return RFM95_internalToRSSI(RFM95_rxRSSI);
+#else
 	return RFM95_internalToRSSI(RFM95.currentPacket.RSSI);
+#endif
 }
 
 LOCAL int8_t RFM95_getReceivingSNR(void)
 {
 	// SNR from last received packet
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	return RFM95_internalToSNR(RFM95_rxSNR);
+#else
 	return RFM95_internalToSNR(RFM95.currentPacket.SNR);
+#endif
 }
 
 LOCAL uint8_t RFM95_getTxPowerPercent(void)
@@ -110,7 +110,7 @@ _SPI;
 #define _SPI SPI					//!< SPI
 #endif
 #else
-#if defined(__arm__)
+#if defined(__arm__) || defined(__linux__)
 #include <SPI.h>
 #else
 extern HardwareSPI SPI;				//!< SPI
@@ -272,6 +272,20 @@ typedef struct {
 	uint8_t reserved : 2;						//!< reserved
 } rfm95_internal_t;
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+/**
+* @brief Received packet queued by the interrupt handler, longer payloads than a message are dropped
+*/
+typedef struct {
+	rfm95_header_t header;						//!< LoRa header
+	uint8_t payload[MAX_MESSAGE_LENGTH];		//!< Payload, i.e. MySensors message
+	uint8_t payloadLen;							//!< Length of payload (excluding header)
+	rfm95_RSSI_t RSSI;							//!< RSSI of the packet
+	rfm95_SNR_t SNR;							//!< SNR of the packet
+	bool released;								//!< Processed, dequeued with the packets received before
+} rfm95_queuedPacket_t;
+#endif
+
 #define LOCAL static		//!< static
 
 /**
@@ -307,6 +321,20 @@ LOCAL bool RFM95_available(void);
 * @return Number of bytes
 */
 LOCAL uint8_t RFM95_recv(uint8_t* buf);
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+/**
+* @brief Oldest received packet not handed out yet, acknowledged if requested. Stays queued until
+* released with @ref RFM95_release().
+* @param len Payload length
+* @return Payload, NULL if none
+*/
+LOCAL uint8_t* RFM95_peek(uint8_t* len);
+/**
+* @brief Release a packet handed out by @ref RFM95_peek()
+* @param payload Payload
+*/
+LOCAL void RFM95_release(uint8_t* payload);
+#endif
 /**
 * @brief RFM95_send
 * @param packet
@@ -24,7 +24,8 @@
 #include <stdlib.h>
 #include "log.h"
 
-static pthread_mutex_t spiMutex = PTHREAD_MUTEX_INITIALIZER;
+// recursive, a driver may hold one transaction over a sequence of transfers
+static pthread_mutex_t spiMutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
 
 // Declare a single default instance
 SPIClass SPI = SPIClass();
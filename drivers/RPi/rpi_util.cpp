@@ -20,42 +20,30 @@
  */
 
 #include "rpi_util.h"
-#include <pthread.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <poll.h>
 #include <string.h>
-#include <sys/types.h>
-#include <sys/stat.h>
 #include <fcntl.h>
-#include <stropts.h>
 #include <errno.h>
+#include <linux/gpio.h>
 #include "SPI.h"
 #include "log.h"
 #include "cpuinfo.h"
+#include "interrupt.h"
 
-extern "C" {
-	int piHiPri(const int pri);
-}
-
-struct ThreadArgs {
-	void (*func)();
-	int gpioPin;
-};
+// GPIO character device, its line offsets are the BCM GPIO numbers
+#define RPI_GPIO_CHIP "/dev/gpiochip0"
 
 static const int *pin_to_gpio = 0;
 static rpi_info rpiinfo;
 
-volatile bool interruptsEnabled = true;
-static pthread_mutex_t intMutex = PTHREAD_MUTEX_INITIALIZER;
+static int chipFd = -1;
 
-static pthread_t *threadIds[64] = {NULL};
-
-// sysFds:
-//	Map a file descriptor from the /sys/class/gpio/gpioX/value
-static int sysFds[64] = {
+// lineFds:
+//	Map a gpio pin to the file descriptor of its interrupt line request
+static int lineFds[64] = {
 	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
@@ -94,54 +82,6 @@ int get_gpio_number(uint8_t physPin, uint8_t *gpio)
 	return 0;
 }
 
-void *interruptHandler(void *args)
-{
-	int fd;
-	struct pollfd polls;
-	char c;
-	struct ThreadArgs *arguments = (struct ThreadArgs *)args;
-	int gpioPin = arguments->gpioPin;
-	void (*func)() = arguments->func;
-	delete arguments;
-
-	(void)piHiPri(55);	// Only effective if we run as root
-
-	if ((fd = sysFds[gpioPin]) == -1) {
-		logError("Failed to attach interrupt for pin %d\n", gpioPin);
-		return NULL;
-	}
-
-	// Setup poll structure
-	polls.fd     = fd;
-	polls.events = POLLPRI;
-
-	while (1) {
-		// Wait for it ...
-		int ret = poll(&polls, 1, -1);
-		if (ret < 0) {
-			logError("Error waiting for interrupt: %s\n", strerror(errno));
-			break;
-		}
-		// Do a dummy read to clear the interrupt
-		//	A one character read appars to be enough.
-		//	Followed by a seek to reset it.
-		(void)read (fd, &c, 1) ;
-		lseek (fd, 0, SEEK_SET) ;
-		// Call user function.
-		pthread_mutex_lock(&intMutex);
-		if (interruptsEnabled) {
-			pthread_mutex_unlock(&intMutex);
-			func();
-		} else {
-			pthread_mutex_unlock(&intMutex);
-		}
-	}
-
-	close(fd);
-
-	return NULL;
-}
-
 void rpi_util::pinMode(uint8_t physPin, uint8_t mode)
 {
 	uint8_t gpioPin;
@@ -199,94 +139,54 @@ uint8_t rpi_util::digitalRead(uint8_t physPin)
 
 void rpi_util::attachInterrupt(uint8_t physPin, void (*func)(), uint8_t mode)
 {
-	FILE *fd;
-	char fName[40];
-	char c;
-	int count, i;
 	uint8_t gpioPin;
+	uint64_t flags = GPIO_V2_LINE_FLAG_INPUT;
 
 	if (get_gpio_number(physPin, &gpioPin)) {
 		logError("attachInterrupt: invalid pin: %d\n", physPin);
 		return;
 	}
 
-	if (threadIds[gpioPin] == NULL) {
-		threadIds[gpioPin] = new pthread_t;
-	} else {
-		// Cancel the existing thread for that pin
-		pthread_cancel(*threadIds[gpioPin]);
-		// Wait a bit
-		delay(1L);
-	}
-
-	// Export pin for interrupt
-	if ((fd = fopen("/sys/class/gpio/export", "w")) == NULL) {
-		logError("attachInterrupt: Unable to export pin %d for interrupt: %s\n", physPin, strerror(errno));
-		exit(1);
-	}
-	fprintf(fd, "%d\n", gpioPin);
-	fclose(fd);
-
-	// Wait a bit the system to create /sys/class/gpio/gpio<GPIO number>
-	delay(1L);
-
-	snprintf(fName, sizeof(fName), "/sys/class/gpio/gpio%d/direction", gpioPin) ;
-	if ((fd = fopen (fName, "w")) == NULL) {
-		logError("attachInterrupt: Unable to open GPIO direction interface for pin %d: %s\n",
-		         physPin, strerror(errno));
-		exit(1) ;
-	}
-	fprintf(fd, "in\n") ;
-	fclose(fd) ;
-
-	snprintf(fName, sizeof(fName), "/sys/class/gpio/gpio%d/edge", gpioPin) ;
-	if ((fd = fopen(fName, "w")) == NULL) {
-		logError("attachInterrupt: Unable to open GPIO edge interface for pin %d: %s\n", physPin,
-		         strerror(errno));
-		exit(1) ;
-	}
 	switch (mode) {
 	case CHANGE:
-		fprintf(fd, "both\n");
+		flags |= GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
 		break;
 	case FALLING:
-		fprintf(fd, "falling\n");
+		flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
 		break;
 	case RISING:
-		fprintf(fd, "rising\n");
+		flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
 		break;
 	case NONE:
-		fprintf(fd, "none\n");
 		break;
 	default:
 		logError("attachInterrupt: Invalid mode\n");
-		fclose(fd);
 		return;
 	}
-	fclose(fd);
 
-	if (sysFds[gpioPin] == -1) {
-		snprintf(fName, sizeof(fName), "/sys/class/gpio/gpio%d/value", gpioPin);
-		if ((sysFds[gpioPin] = open(fName, O_RDWR)) < 0) {
-			logError("Error reading pin %d: %s\n", physPin, strerror(errno));
-			exit(1);
-		}
+	if (chipFd == -1 && (chipFd = open(RPI_GPIO_CHIP, O_RDWR | O_CLOEXEC)) < 0) {
+		logError("attachInterrupt: Unable to open %s: %s\n", RPI_GPIO_CHIP, strerror(errno));
+		exit(1);
 	}
 
-	// Clear any initial pending interrupt
-	ioctl(sysFds[gpioPin], FIONREAD, &count);
-	for (i = 0; i < count; ++i) {
-		if (read(sysFds[gpioPin], &c, 1) == -1) {
-			logError("attachInterrupt: failed to read pin status: %s\n", strerror(errno));
-		}
-	}
+	// Replaces an interrupt attached before, the line is released first or the request fails (EBUSY)
+	detachInterrupt(physPin);
 
-	struct ThreadArgs *threadArgs = new struct ThreadArgs;
-	threadArgs->func = func;
-	threadArgs->gpioPin = gpioPin;
+	// Edge detection starts with the request, no stale events
+	struct gpio_v2_line_request request;
+	memset(&request, 0, sizeof(request));
+	request.offsets[0] = gpioPin;
+	request.num_lines = 1;
+	request.config.flags = flags;
+	strncpy(request.consumer, "mysensors", sizeof(request.consumer) - 1);
+	if (ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+		logError("attachInterrupt: Unable to request pin %d for interrupt: %s\n", physPin,
+		         strerror(errno));
+		exit(1);
+	}
 
-	// Create a thread passing the pin and function
-	pthread_create(threadIds[gpioPin], NULL, interruptHandler, (void *)threadArgs);
+	lineFds[gpioPin] = request.fd;
+	interruptAttach(gpioPin, request.fd, func);
 }
 
 void rpi_util::detachInterrupt(uint8_t physPin)
@@ -298,26 +198,12 @@ void rpi_util::detachInterrupt(uint8_t physPin)
 		return;
 	}
 
-	// Cancel the thread
-	if (threadIds[gpioPin] != NULL) {
-		pthread_cancel(*threadIds[gpioPin]);
-		delete threadIds[gpioPin];
-		threadIds[gpioPin] = NULL;
-	}
-
-	// Close filehandle
-	if (sysFds[gpioPin] != -1) {
-		close(sysFds[gpioPin]);
-		sysFds[gpioPin] = -1;
-	}
-
-	FILE *fp = fopen("/sys/class/gpio/unexport", "w");
-	if (fp == NULL) {
-		logError("Unable to unexport pin %d for interrupt\n", gpioPin);
-		exit(1);
+	if (lineFds[gpioPin] != -1) {
+		interruptDetach(gpioPin);
+		// Release the line
+		close(lineFds[gpioPin]);
+		lineFds[gpioPin] = -1;
 	}
-	fprintf(fp, "%d", gpioPin);
-	fclose(fp);
 }
 
 uint8_t rpi_util::digitalPinToInterrupt(uint8_t physPin)
@@ -328,14 +214,10 @@ uint8_t rpi_util::digitalPinToInterrupt(uint8_t physPin)
 
 void rpi_util::interrupts()
 {
-	pthread_mutex_lock(&intMutex);
-	interruptsEnabled = true;
-	pthread_mutex_unlock(&intMutex);
+	interruptEnable(true);
 }
 
 void rpi_util::noInterrupts()
 {
-	pthread_mutex_lock(&intMutex);
-	interruptsEnabled = false;
-	pthread_mutex_unlock(&intMutex);
+	interruptEnable(false);
 }
@@ -0,0 +1,340 @@
+/**
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2016 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/Arduino/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * DESCRIPTION
+ * Host side benchmark of the signing and encryption code and of the RX message queue, built
+ * with "make benchmark". The signing backend, AES functions and queue are called directly, no
+ * radio traffic is involved.
+ * Cycles are taken from the CPU cycle counter if the kernel exposes it (perf events), otherwise
+ * from the x86 time stamp counter, which ticks at the nominal and not the actual clock rate.
+ */
+
+#include <cstdio>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+// Keep the benchmark away from the gateway configuration file
+#define MY_LINUX_CONFIG_FILE "/tmp/mysbenchmark.dat"
+
+#define MY_CORE_ONLY
+#define MY_SIGNING_SOFT
+
+#include <MySensors.h>
+// Only pulled in by MySensors.h for MY_RF24_ENABLE_ENCRYPTION
+#include "drivers/AES/AES.cpp"
+#include "drivers/CircularBuffer/CircularBuffer.h"
+
+#define BENCHMARK_DURATION_MS (1000ul)
+#define BENCHMARK_QUEUE_SIZE (32)
+#define BENCHMARK_QUEUE_BATCH (8)
+#define BENCHMARK_QUEUE_MESSAGES (4000000ul)
+
+extern uint8_t _doWhitelist[32];
+
+static int _benchmarkCyclesFd = -1;
+
+/**
+ * @brief Accumulated cost of one benchmarked operation.
+ */
+typedef struct {
+	unsigned long count; //!< Number of operations
+	double seconds;      //!< Wall clock time spent in the operations
+	uint64_t cycles;     //!< Cycles spent in the operations, 0 if there is no cycle counter
+} benchmarkResult_t;
+
+static double benchmarkNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void benchmarkCyclesInit(void)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	_benchmarkCyclesFd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t benchmarkCycles(void)
+{
+	uint64_t cycles = 0;
+	if (_benchmarkCyclesFd >= 0) {
+		if (read(_benchmarkCyclesFd, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+			cycles = 0;
+		}
+		return cycles;
+	}
+#if defined(__i386__) || defined(__x86_64__)
+	cycles = __rdtsc();
+#endif
+	return cycles;
+}
+
+static void benchmarkStart(double &start, uint64_t &startCycles)
+{
+	startCycles = benchmarkCycles();
+	start = benchmarkNow();
+}
+
+static void benchmarkStop(benchmarkResult_t &result, double start, uint64_t startCycles)
+{
+	result.seconds += benchmarkNow() - start;
+	result.cycles += benchmarkCycles() - startCycles;
+	result.count++;
+}
+
+static void benchmarkReport(const char* name, const benchmarkResult_t &result)
+{
+	if (result.count == 0) {
+		printf("%-32s failed\n", name);
+		return;
+	}
+	printf("%-32s %10.2f us/op %10.0f cyc/op %12.0f op/s\n", name,
+	       result.seconds * 1e6 / result.count, (double)result.cycles / result.count,
+	       result.count / result.seconds);
+}
+
+static void benchmarkSha256(const char* name, bool blockWrites)
+{
+	static uint8_t data[1024];
+	benchmarkResult_t result = {0, 0, 0};
+	double start;
+	uint64_t startCycles;
+	while (result.seconds < BENCHMARK_DURATION_MS / 1000.0) {
+		benchmarkStart(start, startCycles);
+		signerSha256Init();
+		if (blockWrites) {
+			_soft_sha256.write(data, sizeof(data));
+		} else {
+			for (size_t i = 0; i < sizeof(data); i++) {
+				_soft_sha256.write(data[i]);
+			}
+		}
+		(void)signerSha256Final();
+		benchmarkStop(result, start, startCycles);
+	}
+	printf("%-32s %10.2f MB/s %10.2f cyc/B\n", name,
+	       result.count * sizeof(data) / result.seconds / 1e6,
+	       (double)result.cycles / (result.count * sizeof(data)));
+}
+
+static void benchmarkSigning(void)
+{
+	MyMessage nonce;
+	MyMessage msg;
+	benchmarkResult_t nonces = {0, 0, 0};
+	benchmarkResult_t signs = {0, 0, 0};
+	benchmarkResult_t verifies = {0, 0, 0};
+	unsigned long failed = 0;
+	double start;
+	uint64_t startCycles;
+
+	memset(_doWhitelist, 0xFF, sizeof(_doWhitelist)); // No whitelisting
+	while (signs.seconds + verifies.seconds < BENCHMARK_DURATION_MS / 1000.0) {
+		// Verifier hands out a nonce, signer uses it and the verifier checks the result
+		nonce.sender = 1;
+		benchmarkStart(start, startCycles);
+		(void)signerAtsha204SoftGetNonce(nonce);
+		benchmarkStop(nonces, start, startCycles);
+		// Refill the pre-generated nonce outside of the measurement, as the main loop does
+		(void)signerAtsha204SoftCheckTimer();
+		msg.sender = 1;
+		msg.destination = 0;
+		msg.sensor = 1;
+		msg.type = V_STATUS;
+		mSetCommand(msg, C_SET);
+		msg.set((uint32_t)signs.count);
+
+		benchmarkStart(start, startCycles);
+		signerAtsha204SoftPutNonce(nonce);
+		if (!signerAtsha204SoftSignMsg(msg)) {
+			failed++;
+		}
+		benchmarkStop(signs, start, startCycles);
+
+		benchmarkStart(start, startCycles);
+		if (!signerAtsha204SoftVerifyMsg(msg)) {
+			failed++;
+		}
+		benchmarkStop(verifies, start, startCycles);
+	}
+	if (failed) {
+		printf("Signing or verification failed for %lu of %lu messages!\n", failed, signs.count);
+	}
+	benchmarkReport("soft nonce", nonces);
+	benchmarkReport("soft sign", signs);
+	benchmarkReport("soft verify", verifies);
+}
+
+static void benchmarkAes(uint8_t frameLength)
+{
+	AES aes;
+	uint8_t key[16];
+	uint8_t frame[32];
+	char name[40];
+	benchmarkResult_t encrypts = {0, 0, 0};
+	benchmarkResult_t decrypts = {0, 0, 0};
+	double start;
+	uint64_t startCycles;
+
+	memset(key, 0x5A, sizeof(key));
+	memset(frame, 0, sizeof(frame));
+	(void)aes.set_key(key, sizeof(key));
+	while (encrypts.seconds + decrypts.seconds < BENCHMARK_DURATION_MS / 1000.0) {
+		// Same sequence as the RF24 transport does for every frame
+		benchmarkStart(start, startCycles);
+		aes.set_IV(0);
+		(void)aes.cbc_encrypt(frame, frame, frameLength / 16);
+		benchmarkStop(encrypts, start, startCycles);
+
+		benchmarkStart(start, startCycles);
+		aes.set_IV(0);
+		(void)aes.cbc_decrypt(frame, frame, frameLength / 16);
+		benchmarkStop(decrypts, start, startCycles);
+	}
+	snprintf(name, sizeof(name), "aes128 cbc encrypt %uB", frameLength);
+	benchmarkReport(name, encrypts);
+	snprintf(name, sizeof(name), "aes128 cbc decrypt %uB", frameLength);
+	benchmarkReport(name, decrypts);
+}
+
+/**
+ * @brief Record as queued by the RX message buffer.
+ */
+typedef struct {
+	uint8_t len;                        //!< Length of the data
+	uint8_t data[MAX_MESSAGE_LENGTH];   //!< The raw data
+} benchmarkQueuedMessage;
+
+typedef CircularBuffer<benchmarkQueuedMessage, BENCHMARK_QUEUE_SIZE> benchmarkQueue_t;
+
+static void *benchmarkQueueProducer(void *args)
+{
+	benchmarkQueue_t *queue = (benchmarkQueue_t *)args;
+	for (unsigned long i = 0; i < BENCHMARK_QUEUE_MESSAGES; ) {
+		// As the interrupt handler does: fill the front record in place and push it
+		benchmarkQueuedMessage *msg = queue->getFront();
+		if (msg) {
+			msg->len = (uint8_t)i;
+			(void)queue->pushFront(msg);
+			i++;
+		} else {
+			// Full, let the consumer run if it shares the CPU
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void benchmarkQueue(void)
+{
+	static benchmarkQueue_t queue;
+	benchmarkQueuedMessage records[BENCHMARK_QUEUE_BATCH];
+	benchmarkResult_t singles = {0, 0, 0};
+	benchmarkResult_t batches = {0, 0, 0};
+	benchmarkResult_t threads = {0, 0, 0};
+	unsigned long failed = 0;
+	double start;
+	uint64_t startCycles;
+
+	memset(records, 0, sizeof(records));
+	while (singles.seconds + batches.seconds < BENCHMARK_DURATION_MS / 1000.0) {
+		benchmarkStart(start, startCycles);
+		for (uint8_t i = 0; i < BENCHMARK_QUEUE_BATCH; i++) {
+			benchmarkQueuedMessage *msg = queue.getFront();
+			msg->len = i;
+			(void)queue.pushFront(msg);
+		}
+		for (uint8_t i = 0; i < BENCHMARK_QUEUE_BATCH; i++) {
+			if (queue.getBack()->len != i) {
+				failed++;
+			}
+			(void)queue.popBack();
+		}
+		benchmarkStop(singles, start, startCycles);
+
+		benchmarkStart(start, startCycles);
+		(void)queue.pushFront(records, BENCHMARK_QUEUE_BATCH);
+		if (queue.popBack(records, BENCHMARK_QUEUE_BATCH) != BENCHMARK_QUEUE_BATCH) {
+			failed++;
+		}
+		benchmarkStop(batches, start, startCycles);
+	}
+
+	// Producer and consumer on their own threads, as the interrupt thread and the main loop
+	pthread_t producer;
+	benchmarkStart(start, startCycles);
+	if (pthread_create(&producer, NULL, benchmarkQueueProducer, &queue)) {
+		printf("Unable to start the producer thread\n");
+		return;
+	}
+	for (unsigned long i = 0; i < BENCHMARK_QUEUE_MESSAGES; ) {
+		const benchmarkQueuedMessage *msg = queue.getBack();
+		if (msg) {
+			if (msg->len != (uint8_t)i) {
+				failed++;
+			}
+			(void)queue.popBack();
+			i++;
+		} else {
+			sched_yield();
+		}
+	}
+	pthread_join(producer, NULL);
+	benchmarkStop(threads, start, startCycles);
+	// Per message, not per run
+	threads.count = BENCHMARK_QUEUE_MESSAGES;
+
+	if (failed) {
+		printf("Queue returned %lu records out of order!\n", failed);
+	}
+	singles.count *= BENCHMARK_QUEUE_BATCH;
+	batches.count *= BENCHMARK_QUEUE_BATCH;
+	benchmarkReport("queue push+pop", singles);
+	benchmarkReport("queue push+pop batch", batches);
+	benchmarkReport("queue push+pop two threads", threads);
+}
+
+int main(void)
+{
+	benchmarkCyclesInit();
+	signerAtsha204SoftInit();
+
+	benchmarkSha256("sha256 byte writes", false);
+	benchmarkSha256("sha256 block writes", true);
+	benchmarkSigning();
+	benchmarkAes(16);
+	benchmarkAes(32);
+	benchmarkQueue();
+	return 0;
+}